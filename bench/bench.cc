@@ -0,0 +1,316 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include "synth.h"
+#include "../src/data.h"
+#include "../src/midi.h"
+#include "../src/input.h"
+#include "../src/output.h"
+#include "../src/progress.h"
+#include "../src/stats.h"
+
+using std::sort;
+using std::string;
+using std::to_string;
+using std::unique_ptr;
+using std::vector;
+using std::chrono::steady_clock;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+namespace {
+  struct benchSettings {
+    long long minNotes;
+    long long maxNotes;
+    int tracks;
+    int polyphony;
+    int tempoChanges;
+    int meterChanges;
+    int queries;
+    string dir;
+    bool keep;
+    // allowance on top of the output jitter target for noisy machines, in microseconds
+    long long jitterSlack;
+  };
+
+  double elapsedMs(steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(steady_clock::now() - start).count();
+  }
+
+  long long peakResidentBytes() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss * 1024ll;
+  }
+
+  // one line of the report, throughput is items per second
+  void row(const string& name, long long notes, double ms, long long items, long long allocated, long long resident) {
+    printf("%-16s %12lld %12.2f %14.0f %12.1f %12.1f\n", name.c_str(), notes, ms, ms > 0 ? items * 1000.0 / ms : 0,
+           allocated / 1048576.0, resident / 1048576.0);
+  }
+
+  double stageMs(loadStats& stats, const string& name) {
+    for (const loadStage& stage : stats.getStages()) {
+      if (stage.name == name) {
+        return stage.ms;
+      }
+    }
+    return 0;
+  }
+
+  void benchLoad(const benchSettings& settings, const string& path, long long notes) {
+    unique_ptr<midi> file(new midi());
+    loadProgress progress;
+
+    long long allocated = getAllocatedBytes();
+    steady_clock::time_point start = steady_clock::now();
+    if (!file->load(path, SHEET_DEFAULT_SIZE, &progress)) {
+      printf("load failed: %s\n", path.c_str());
+      return;
+    }
+    double ms = elapsedMs(start);
+    row("load", notes, ms, notes, getAllocatedBytes() - allocated, getResidentBytes());
+
+    // layout and line building are load stages, their share comes from the load report
+    loadStats& stats = file->getLoadStats();
+    long long measures = file->measureMap.size();
+    row("measure layout", notes, stageMs(stats, "measure length") + stageMs(stats, "page wrap"), measures, 0, 0);
+    row("line map", notes, stageMs(stats, "line map"), notes, 0, 0);
+
+    // screen-sized windows at random places in the song
+    noteStore& store = file->store;
+    double songEnd = store.start.back() + store.duration.back();
+    double window = 4000;
+    vector<int> result;
+    srand(1);
+
+    start = steady_clock::now();
+    for (int i = 0; i < settings.queries; i++) {
+      double from = songEnd * (rand() / double(RAND_MAX));
+      file->findVisibleNotes(from, from + window, result);
+    }
+    row("cull notes", notes, elapsedMs(start), settings.queries, 0, 0);
+
+    start = steady_clock::now();
+    for (int i = 0; i < settings.queries; i++) {
+      double from = songEnd * (rand() / double(RAND_MAX));
+      file->findVisibleLines(from, from + window, result);
+    }
+    row("cull lines", notes, elapsedMs(start), settings.queries, 0, 0);
+  }
+
+  // note on/off pairs fed through the receive callback in ring-sized batches, as a port would
+  void benchLive(long long notes) {
+    unique_ptr<midiInput> input;
+    try {
+      input.reset(new midiInput());
+    }
+    catch (...) {
+      printf("live input skipped, no MIDI backend\n");
+      return;
+    }
+
+    long long allocated = getAllocatedBytes();
+    steady_clock::time_point start = steady_clock::now();
+    vector<unsigned char> message(3);
+    long long sent = 0;
+    while (sent < notes) {
+      for (int i = 0; i < INPUT_RING_SIZE / 2 && sent < notes; i++, sent++) {
+        uint8_t key = 21 + sent % 88;
+        message = {0x90, key, 100};
+        midiInput::receive(0, &message, input.get());
+        message = {0x80, key, 0};
+        midiInput::receive(0, &message, input.get());
+        input->advance(1);
+      }
+      input->update(0);
+    }
+    row("live input", notes, elapsedMs(start), notes, getAllocatedBytes() - allocated, getResidentBytes());
+  }
+
+  // a message the output should send, song time and the order it goes in at that time
+  struct expectedMessage {
+    double time;
+    int rank;
+    uint8_t data[3];
+  };
+
+  // plays a short song on four channels into a recording sink, every message has to come out
+  // in order, not early, and within the jitter target (plus any slack given) of its due time
+  bool benchOutput(const benchSettings& settings) {
+    unique_ptr<midiOutput> output;
+    try {
+      output.reset(new midiOutput());
+    }
+    catch (...) {
+      printf("output skipped, no MIDI backend\n");
+      return true;
+    }
+
+    // notes every 50 ms cycling the channels, each channel gets its program before its first note,
+    // and channel 3 changes program and volume on the same tick as a note of its own
+    const int noteCount = 40;
+    const long long limit = OUTPUT_JITTER_TARGET + settings.jitterSlack;
+    noteStore store;
+    vector<expectedMessage> expected;
+    for (int c = 0; c < 4; c++) {
+      store.controls.push_back({double(c), {uint8_t(0xC0 | c), uint8_t(c + 1), 0}});
+    }
+    store.controls.push_back({500, {0xC3, 40, 0}});
+    store.controls.push_back({500, {0xB3, 7, 90}});
+    for (const channelEvent& c : store.controls) {
+      expected.push_back({c.time, 1, {c.data[0], c.data[1], c.data[2]}});
+    }
+    for (int i = 0; i < noteCount; i++) {
+      double start = 25 + i * 25;
+      int channel = i % 4;
+      uint8_t key = 60 + i % 12;
+      store.add(start, 20, key, 0, 100, channel);
+      expected.push_back({start, 2, {uint8_t(0x90 | channel), key, 100}});
+      expected.push_back({start + 20, 0, {uint8_t(0x80 | channel), key, 0}});
+    }
+    store.finish();
+    // the two changes at 500 share a rank, keep the order they were added in
+    stable_sort(expected.begin(), expected.end(), [](const expectedMessage& left, const expectedMessage& right) {
+      return left.time != right.time ? left.time < right.time : left.rank < right.rank;
+    });
+
+    vector<steady_clock::time_point> sentAt;
+    vector<vector<uint8_t>> sent;
+    output->setSink([&](const uint8_t* data, int size) {
+      sentAt.push_back(steady_clock::now());
+      sent.push_back(vector<uint8_t>(data, data + size));
+    });
+
+    transport clock;
+    clock.play();
+    steady_clock::time_point start = steady_clock::now();
+    output->play(&store, clock);
+    while (output->isPlaying()) {
+      std::this_thread::sleep_for(milliseconds(10));
+    }
+    output->stop();
+    double ms = elapsedMs(start);
+
+    bool ok = sent.size() == expected.size();
+    long long maxLate = 0;
+    for (unsigned int i = 0; ok && i < sent.size(); i++) {
+      const expectedMessage& e = expected[i];
+      int size = (e.data[0] & 0xF0) == 0xC0 ? 2 : 3;
+      ok = (int)sent[i].size() == size && std::equal(sent[i].begin(), sent[i].end(), e.data);
+      long long late = duration_cast<microseconds>(sentAt[i] - clock.toClock(e.time)).count();
+      ok = ok && late >= -OUTPUT_BATCH && late <= limit;
+      maxLate = std::max(maxLate, late);
+      if (!ok) {
+        printf("output message %u out of order or off time, %lld us late\n", i, late);
+      }
+    }
+    if (sent.size() != expected.size()) {
+      printf("output sent %zu messages, expected %zu\n", sent.size(), expected.size());
+    }
+    // the scheduler measures its own lateness just before each send, it has to meet the limit as well
+    ok = ok && output->getMaxJitter() <= limit;
+    row("output", noteCount, ms, sent.size(), 0, 0);
+    printf("output max late %.3f ms, scheduler reported %.3f ms, limit %.3f ms (target %.3f + slack %.3f)%s\n",
+           maxLate / 1000.0, output->getMaxJitter() / 1000.0, limit / 1000.0, OUTPUT_JITTER_TARGET / 1000.0,
+           settings.jitterSlack / 1000.0, ok ? "" : ", FAILED");
+    return ok;
+  }
+
+  bool parseArgs(int argc, char* argv[], benchSettings& settings, string& generate, long long& generateNotes) {
+    settings = {1000, 1000000, 16, 3, 8, 4, 10000, "/tmp", false, 0};
+    generate = "";
+    generateNotes = 100000;
+
+    for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      bool hasValue = i + 1 < argc;
+      if (arg == "--min" && hasValue) {
+        settings.minNotes = atof(argv[++i]);
+      }
+      else if (arg == "--max" && hasValue) {
+        settings.maxNotes = atof(argv[++i]);
+      }
+      else if (arg == "--tracks" && hasValue) {
+        settings.tracks = atoi(argv[++i]);
+      }
+      else if (arg == "--polyphony" && hasValue) {
+        settings.polyphony = atoi(argv[++i]);
+      }
+      else if (arg == "--tempo-changes" && hasValue) {
+        settings.tempoChanges = atoi(argv[++i]);
+      }
+      else if (arg == "--meter-changes" && hasValue) {
+        settings.meterChanges = atoi(argv[++i]);
+      }
+      else if (arg == "--queries" && hasValue) {
+        settings.queries = atoi(argv[++i]);
+      }
+      else if (arg == "--dir" && hasValue) {
+        settings.dir = argv[++i];
+      }
+      else if (arg == "--jitter-slack" && hasValue) {
+        settings.jitterSlack = atof(argv[++i]) * 1000;
+      }
+      else if (arg == "--keep") {
+        settings.keep = true;
+      }
+      else if (arg == "--generate" && hasValue) {
+        generate = argv[++i];
+      }
+      else if (arg == "--notes" && hasValue) {
+        generateNotes = atof(argv[++i]);
+      }
+      else {
+        printf("usage: kelumi-bench [--min N] [--max N] [--tracks N] [--polyphony N] [--tempo-changes N]\n"
+               "                    [--meter-changes N] [--queries N] [--dir DIR] [--keep] [--jitter-slack MS]\n"
+               "       kelumi-bench --generate <file.mid> [--notes N] [--tracks N] ...\n");
+        return false;
+      }
+    }
+    return settings.minNotes > 0 && settings.maxNotes >= settings.minNotes;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  benchSettings settings;
+  string generate;
+  long long generateNotes;
+  if (!parseArgs(argc, argv, settings, generate, generateNotes)) {
+    return 1;
+  }
+
+  if (!generate.empty()) {
+    synthSpec spec = {generateNotes, settings.tracks, settings.polyphony, settings.tempoChanges, settings.meterChanges, 480, 1};
+    return writeSynthMidi(generate, spec) ? 0 : 1;
+  }
+
+  // 10^8 notes needs several GB for the loaded file, pass --max to go that far
+  printf("%-16s %12s %12s %14s %12s %12s\n", "benchmark", "notes", "ms", "per second", "MB alloc", "MB resident");
+  for (long long notes = settings.minNotes; notes <= settings.maxNotes; notes *= 10) {
+    string path = settings.dir + "/kelumi-bench-" + to_string(notes) + ".mid";
+    synthSpec spec = {notes, settings.tracks, settings.polyphony, settings.tempoChanges, settings.meterChanges, 480, 1};
+
+    steady_clock::time_point start = steady_clock::now();
+    if (!writeSynthMidi(path, spec)) {
+      return 1;
+    }
+    row("generate", notes, elapsedMs(start), notes, 0, 0);
+
+    benchLoad(settings, path, notes);
+    benchLive(notes);
+
+    if (!settings.keep) {
+      remove(path.c_str());
+    }
+  }
+  bool played = benchOutput(settings);
+  printf("peak resident %.1f MB\n", peakResidentBytes() / 1048576.0);
+  return played ? 0 : 1;
+}
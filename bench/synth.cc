@@ -0,0 +1,139 @@
+#include <cstdio>
+#include <cstdint>
+#include <vector>
+#include "synth.h"
+#include "../src/log.h"
+
+using std::vector;
+
+namespace {
+  // numerical recipes LCG, plenty for spreading pitches and velocities
+  struct lcg {
+    uint32_t state;
+    uint32_t next() {
+      state = state * 1664525u + 1013904223u;
+      return state >> 8;
+    }
+  };
+
+  class trackWriter {
+    public:
+      trackWriter(FILE* out) : file(out), lastTick(0), length(0) {
+        fwrite("MTrk\0\0\0\0", 1, 8, file);
+        start = ftell(file);
+      }
+
+      void event(long long tick, const vector<uint8_t>& data) {
+        writeVarLen(tick - lastTick);
+        lastTick = tick;
+        fwrite(data.data(), 1, data.size(), file);
+        length += data.size();
+      }
+
+      // patches the chunk length now that it is known
+      void close(long long tick) {
+        event(tick, {0xFF, 0x2F, 0x00});
+        long end = ftell(file);
+        fseek(file, start - 4, SEEK_SET);
+        uint8_t size[4] = {uint8_t(length >> 24), uint8_t(length >> 16), uint8_t(length >> 8), uint8_t(length)};
+        fwrite(size, 1, 4, file);
+        fseek(file, end, SEEK_SET);
+      }
+
+    private:
+      void writeVarLen(long long value) {
+        uint8_t bytes[10];
+        int count = 0;
+        bytes[count++] = value & 0x7F;
+        while (value >>= 7) {
+          bytes[count++] = 0x80 | (value & 0x7F);
+        }
+        for (int i = count - 1; i >= 0; i--) {
+          fputc(bytes[i], file);
+        }
+        length += count;
+      }
+
+      FILE* file;
+      long start;
+      long long lastTick;
+      long long length;
+  };
+}
+
+bool writeSynthMidi(const string& filename, const synthSpec& spec) {
+  if (spec.notes <= 0 || spec.tracks <= 0 || spec.polyphony <= 0 || spec.tpq <= 0) {
+    logII(LL_WARN, "invalid synthetic file spec");
+    return false;
+  }
+  FILE* out = fopen(filename.c_str(), "wb");
+  if (out == nullptr) {
+    logII(LL_WARN, "unable to write " + filename);
+    return false;
+  }
+
+  // each track plays a chord every eighth note, released before the next one
+  long long step = spec.tpq / 2;
+  long long perTrack = (spec.notes + spec.tracks - 1) / spec.tracks;
+  long long songLength = ((perTrack + spec.polyphony - 1) / spec.polyphony + 1) * step;
+
+  int trackCount = spec.tracks + 1;
+  uint8_t header[14] = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, uint8_t(trackCount >> 8), uint8_t(trackCount),
+                        uint8_t(spec.tpq >> 8), uint8_t(spec.tpq)};
+  fwrite(header, 1, 14, out);
+  lcg random = {spec.seed};
+
+  // conductor track, changes are spread evenly and land on whole notes
+  {
+    trackWriter conductor(out);
+    const uint8_t meters[5][2] = {{4, 2}, {3, 2}, {6, 3}, {5, 2}, {7, 3}};
+    long long wholeNote = spec.tpq * 4;
+    int changes = spec.tempoChanges > spec.meterChanges ? spec.tempoChanges : spec.meterChanges;
+    for (int i = 0; i <= changes; i++) {
+      long long tick = songLength * i / (changes + 1) / wholeNote * wholeNote;
+      if (i <= spec.meterChanges) {
+        const uint8_t* meter = meters[i % 5];
+        conductor.event(tick, {0xFF, 0x58, 0x04, meter[0], meter[1], 24, 8});
+      }
+      if (i <= spec.tempoChanges) {
+        uint32_t tempo = 60000000 / (60 + random.next() % 121);
+        conductor.event(tick, {0xFF, 0x51, 0x03, uint8_t(tempo >> 16), uint8_t(tempo >> 8), uint8_t(tempo)});
+      }
+    }
+    conductor.close(songLength);
+  }
+
+  for (int t = 0; t < spec.tracks; t++) {
+    trackWriter track(out);
+    uint8_t channel = t % 16;
+    long long remaining = spec.notes / spec.tracks + (t < spec.notes % spec.tracks);
+
+    for (long long tick = 0; remaining > 0; tick += step) {
+      int size = remaining < spec.polyphony ? remaining : spec.polyphony;
+      int root = 21 + random.next() % 88;
+      long long duration = step / 2 + random.next() % (step / 2 + 1);
+      if (duration >= step) {
+        duration = step - 1;
+      }
+
+      // chord tones are spread by fourths and folded back into the piano range
+      for (int i = 0; i < size; i++) {
+        uint8_t pitch = 21 + (root - 21 + i * 5) % 88;
+        track.event(tick, {uint8_t(0x90 | channel), pitch, uint8_t(40 + random.next() % 80)});
+      }
+      for (int i = 0; i < size; i++) {
+        uint8_t pitch = 21 + (root - 21 + i * 5) % 88;
+        track.event(tick + duration, {uint8_t(0x80 | channel), pitch, 0});
+      }
+      remaining -= size;
+    }
+    track.close(songLength);
+  }
+
+  bool success = !ferror(out);
+  fclose(out);
+  if (!success) {
+    logII(LL_WARN, "unable to write " + filename);
+  }
+  return success;
+}
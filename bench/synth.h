@@ -0,0 +1,21 @@
+#pragma once
+
+#include <string>
+
+using std::string;
+
+// shape of a generated MIDI file, the same spec and seed always give the same file
+struct synthSpec {
+  long long notes;
+  // note tracks, a conductor track for tempo and meter is added in front
+  int tracks;
+  // notes per chord
+  int polyphony;
+  int tempoChanges;
+  int meterChanges;
+  int tpq;
+  unsigned int seed;
+};
+
+// writes a format 1 SMF straight to disk, so the note count is only bounded by the disk
+bool writeSynthMidi(const string& filename, const synthSpec& spec);
@@ -0,0 +1,24 @@
+#include <cstdlib>
+#include <new>
+#include "stats.h"
+
+// replaces the global operator new so load stages can report their allocations, kept out of the
+// core library so only the programs that want the counts link it
+
+// every other form of new and delete in the standard library goes through these two
+void* operator new(size_t size) {
+  recordAllocation(size);
+  void* block = malloc(size ? size : 1);
+  if (block == nullptr) {
+    throw std::bad_alloc();
+  }
+  return block;
+}
+
+void operator delete(void* block) noexcept {
+  free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+  free(block);
+}
@@ -0,0 +1,299 @@
+#define GL_GLEXT_PROTOTYPES
+#include <algorithm>
+#include <GL/gl.h>
+#include <GL/glext.h>
+#include <rlgl.h>
+#include "batch.h"
+#include "define.h"
+#include "log.h"
+#include "profile.h"
+
+using std::min;
+using std::max;
+using std::sort;
+using std::lower_bound;
+using std::upper_bound;
+
+static const char* barVertexShader = R"(
+#version 330
+layout(location = 0) in vec2 corner;
+layout(location = 1) in vec4 span;
+layout(location = 2) in float pitch;
+layout(location = 3) in vec4 colorOff;
+layout(location = 4) in vec4 colorOn;
+
+uniform vec2 screen;
+uniform vec4 view;
+uniform vec4 lane;
+
+out vec4 barColor;
+
+void main() {
+  // view: time offset, zoom, now line x, now time
+  // lane: bottom, lane step, note height, lowest key
+  float x = view.z + (span.x - view.x) * view.y;
+  float w = max(span.y * view.y, 1.0);
+  float y = lane.x - lane.y * (pitch - lane.w + 3.0);
+  vec2 p = vec2(x + corner.x * w, y + corner.y * lane.z);
+
+  barColor = (view.w >= span.z && view.w < span.w) ? colorOn : colorOff;
+  gl_Position = vec4(p.x / screen.x * 2.0 - 1.0, 1.0 - p.y / screen.y * 2.0, 0.0, 1.0);
+}
+)";
+
+static const char* barFragmentShader = R"(
+#version 330
+in vec4 barColor;
+out vec4 finalColor;
+
+void main() {
+  finalColor = barColor;
+}
+)";
+
+static unsigned int compileShader(unsigned int type, const char* code) {
+  unsigned int shader = glCreateShader(type);
+  glShaderSource(shader, 1, &code, nullptr);
+  glCompileShader(shader);
+
+  int status = 0;
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if (!status) {
+    char msg[512];
+    glGetShaderInfoLog(shader, sizeof(msg), nullptr, msg);
+    logII(LL_WARN, "unable to compile bar shader: " + string(msg));
+    glDeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+bool barRenderer::init() {
+  if (program) {
+    return true;
+  }
+
+  unsigned int vs = compileShader(GL_VERTEX_SHADER, barVertexShader);
+  unsigned int fs = compileShader(GL_FRAGMENT_SHADER, barFragmentShader);
+  if (!vs || !fs) {
+    return false;
+  }
+
+  program = glCreateProgram();
+  glAttachShader(program, vs);
+  glAttachShader(program, fs);
+  glLinkProgram(program);
+  glDeleteShader(vs);
+  glDeleteShader(fs);
+
+  int status = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &status);
+  if (!status) {
+    logII(LL_WARN, "unable to link bar shader");
+    glDeleteProgram(program);
+    program = 0;
+    return false;
+  }
+
+  locScreen = glGetUniformLocation(program, "screen");
+  locView = glGetUniformLocation(program, "view");
+  locLane = glGetUniformLocation(program, "lane");
+
+  // two triangles, shared by every instance
+  const float quad[12] = {0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1};
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &quadBuffer);
+  glBindBuffer(GL_ARRAY_BUFFER, quadBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glEnableVertexAttribArray(0);
+
+  glGenBuffers(1, &pieceBuffer);
+  glGenBuffers(1, &colorBuffer);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  return true;
+}
+
+void barRenderer::load(noteStore& store) {
+  ready = false;
+  if (!init()) {
+    return;
+  }
+
+  vector<piece> pieces;
+  pieces.reserve(store.size());
+  pieceNotes.clear();
+  pieceNotes.reserve(store.size());
+
+  for (int i = 0; i < store.size(); i++) {
+    // bars start at the truncated position, as convertSSX does
+    double x = static_cast<int>(store.start[i]);
+    double duration = max(store.duration[i], 0.0);
+    double offset = 0;
+    do {
+      float length = min(duration - offset, static_cast<double>(BATCH_PIECE_LENGTH));
+      pieces.push_back({float(x + offset), length, float(store.start[i]), float(store.start[i] + duration), float(store.pitch[i])});
+      pieceNotes.push_back(i);
+      offset += BATCH_PIECE_LENGTH;
+    } while (offset < duration);
+  }
+
+  // sort pieces by start so the visible range is contiguous
+  vector<int> order(pieces.size());
+  for (unsigned int i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  sort(order.begin(), order.end(), [&](int left, int right) {
+    if (pieces[left].start != pieces[right].start) {
+      return pieces[left].start < pieces[right].start;
+    }
+    return left < right;
+  });
+
+  vector<piece> sorted(pieces.size());
+  vector<int> sortedNotes(pieces.size());
+  pieceStarts.resize(pieces.size());
+  for (unsigned int i = 0; i < order.size(); i++) {
+    sorted[i] = pieces[order[i]];
+    sortedNotes[i] = pieceNotes[order[i]];
+    pieceStarts[i] = sorted[i].start;
+  }
+  pieceNotes.swap(sortedNotes);
+  instanceCount = sorted.size();
+
+  glBindVertexArray(vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pieceBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sorted.size() * sizeof(piece), sorted.data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(piece), nullptr);
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(piece), (void*)(4 * sizeof(float)));
+  glVertexAttribDivisor(1, 1);
+  glVertexAttribDivisor(2, 1);
+  glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
+
+  glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+  glBufferData(GL_ARRAY_BUFFER, sorted.size() * 8, nullptr, GL_DYNAMIC_DRAW);
+  glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 8, nullptr);
+  glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, 8, (void*)4);
+  glVertexAttribDivisor(3, 1);
+  glVertexAttribDivisor(4, 1);
+  glEnableVertexAttribArray(3);
+  glEnableVertexAttribArray(4);
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  // force a color upload on the next frame
+  lastMode = -1;
+  ready = instanceCount > 0;
+}
+
+void barRenderer::unload() {
+  if (program) {
+    glDeleteBuffers(1, &quadBuffer);
+    glDeleteBuffers(1, &pieceBuffer);
+    glDeleteBuffers(1, &colorBuffer);
+    glDeleteVertexArrays(1, &vao);
+    glDeleteProgram(program);
+  }
+  program = 0;
+  pieceStarts.clear();
+  pieceNotes.clear();
+  instanceCount = 0;
+  ready = false;
+}
+
+bool barRenderer::colorsChanged(vector<colorRGB>* on, vector<colorRGB>* off, int mode, int tonic) {
+  if (mode != lastMode || tonic != lastTonic || on->size() != lastOn.size() || off->size() != lastOff.size()) {
+    return true;
+  }
+  for (unsigned int i = 0; i < on->size(); i++) {
+    if (!(on->at(i) == lastOn[i]) || !(off->at(i) == lastOff[i])) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void barRenderer::setColors(noteStore& store, vector<colorRGB>* on, vector<colorRGB>* off, int mode, int tonic) {
+  if (!ready || !colorsChanged(on, off, mode, tonic)) {
+    return;
+  }
+  lastOn = *on;
+  lastOff = *off;
+  lastMode = mode;
+  lastTonic = tonic;
+
+  vector<unsigned char> colors(instanceCount * 8, 0);
+  for (int i = 0; i < instanceCount; i++) {
+    int n = pieceNotes[i];
+    int colorID = 0;
+    switch (mode) {
+      case COLOR_PART:
+        colorID = store.track[n];
+        break;
+      case COLOR_VELOCITY:
+        colorID = store.velocity[n];
+        break;
+      case COLOR_TONIC:
+        colorID = (store.pitch[n] - MIN_NOTE_IDX + tonic) % 12;
+        break;
+    }
+    if (colorID < 0 || colorID >= (int)on->size()) {
+      continue;
+    }
+    const colorRGB& cOff = off->at(colorID);
+    const colorRGB& cOn = on->at(colorID);
+    unsigned char* c = &colors[i * 8];
+    c[0] = cOff.r; c[1] = cOff.g; c[2] = cOff.b; c[3] = 255;
+    c[4] = cOn.r;  c[5] = cOn.g;  c[6] = cOn.b;  c[7] = 255;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, colors.size(), colors.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void barRenderer::draw(const rollView& view, double start, double end) {
+  if (!ready) {
+    return;
+  }
+
+  int first = lower_bound(pieceStarts.begin(), pieceStarts.end(), start - BATCH_PIECE_LENGTH) - pieceStarts.begin();
+  int last = upper_bound(pieceStarts.begin(), pieceStarts.end(), end) - pieceStarts.begin();
+  if (first >= last) {
+    return;
+  }
+
+  // flush raylib's batch so bars land on top of what was drawn before
+  rlglDraw();
+  profiler.count(COUNT_DRAWCALLS);
+
+  glUseProgram(program);
+  glUniform2f(locScreen, view.width, view.height);
+  glUniform4f(locView, view.timeOffset, view.zoom, view.nowX, view.timeOffset);
+  glUniform4f(locLane, view.bottom, view.laneStep, view.noteHeight, MIN_NOTE_IDX);
+
+  glBindVertexArray(vao);
+
+  // point the instanced attributes at the first visible piece
+  glBindBuffer(GL_ARRAY_BUFFER, pieceBuffer);
+  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(piece), (void*)(first * sizeof(piece)));
+  glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(piece), (void*)(first * sizeof(piece) + 4 * sizeof(float)));
+  glBindBuffer(GL_ARRAY_BUFFER, colorBuffer);
+  glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, 8, (void*)(first * 8l));
+  glVertexAttribPointer(4, 4, GL_UNSIGNED_BYTE, GL_TRUE, 8, (void*)(first * 8l + 4));
+
+  glDrawArraysInstanced(GL_TRIANGLES, 0, 6, last - first);
+
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include "store.h"
+#include "color.h"
+
+using std::vector;
+
+// longest bar drawn as a single instance, longer notes are split so the
+// start-sorted buffer can be range culled with a fixed lookback
+#define BATCH_PIECE_LENGTH 2000
+
+// screen mapping of the piano roll, matching convertSSX/convertSSY in main
+struct rollView {
+  double timeOffset;
+  double zoom;
+  float nowX;
+  float bottom;
+  float laneStep;
+  float noteHeight;
+  float width;
+  float height;
+};
+
+// piano roll bars kept in a persistent GPU buffer, drawn with one instanced call
+class barRenderer {
+  public:
+    barRenderer() {
+      pieceStarts = {};
+      pieceNotes = {};
+      lastOn = {};
+      lastOff = {};
+      lastMode = -1;
+      lastTonic = -1;
+      instanceCount = 0;
+      ready = false;
+    }
+
+    void load(noteStore& store);
+    void unload();
+    void setColors(noteStore& store, vector<colorRGB>* on, vector<colorRGB>* off, int mode, int tonic);
+    void draw(const rollView& view, double start, double end);
+
+    bool isReady() { return ready; }
+
+  private:
+    struct piece {
+      float start;
+      float length;
+      float noteStart;
+      float noteEnd;
+      float y;
+    };
+
+    bool init();
+    bool colorsChanged(vector<colorRGB>* on, vector<colorRGB>* off, int mode, int tonic);
+
+    vector<double> pieceStarts;
+    vector<int> pieceNotes;
+
+    vector<colorRGB> lastOn;
+    vector<colorRGB> lastOff;
+    int lastMode;
+    int lastTonic;
+
+    unsigned int program = 0;
+    unsigned int vao = 0;
+    unsigned int quadBuffer = 0;
+    unsigned int pieceBuffer = 0;
+    unsigned int colorBuffer = 0;
+
+    int locScreen = -1;
+    int locView = -1;
+    int locLane = -1;
+
+    int instanceCount;
+    bool ready;
+};
@@ -10,12 +10,13 @@ void controller::toggleLivePlay() {
   if (setTrackOn.size() < 1) {
     getColorScheme(2, setTrackOn, setTrackOff);
   }
+  output.stop();
   livePlayState = !livePlayState;
   if (livePlayState) {
-    notes = &liveInput.noteStream.notes;
+    store = &liveInput.noteStream.store;
   }
   else {
-    notes = &file.notes;
+    store = streamState ? &stream->store : &file.store;
   }
 }
 
@@ -23,19 +24,30 @@ int controller::getTrackCount() {
   if (livePlayState) {
     return 1;
   }
+  if (streamState) {
+    return stream->getTrackCount();
+  }
   return file.getTrackCount();
 }
 
 int controller::getNoteCount() {
   if (livePlayState) {
-    return liveInput.getNoteCount();
+    // the store in view, which holds notes read back from the log while scrolled back
+    return store->size();
+  }
+  if (streamState) {
+    return stream->getNoteCount();
   }
   return file.getNoteCount();
 }
 
 int controller::getLastTime() {
   if (livePlayState) {
-    return 0;
+    // rounded up so moving the view to the end follows the live clock again
+    return ceil(liveInput.getOffset());
+  }
+  if (streamState) {
+    return stream->getLastTime();
   }
   return file.getLastTime();
 }
@@ -49,9 +61,159 @@ int controller::getTempo(int idx) {
   }
 }
 
+void controller::getVisibleNotes(double start, double end, vector<int>& result) {
+  if (livePlayState) {
+    // live notes are not indexed, scrolled back past the resident ones the view draws a copy
+    store = liveInput.getViewStore(start, end);
+    result.resize(store->size());
+    for (int i = 0; i < store->size(); i++) {
+      result[i] = i;
+    }
+    return;
+  }
+  if (streamState) {
+    stream->update(start, end);
+    stream->findVisibleNotes(start, end, result);
+    return;
+  }
+  file.findVisibleNotes(start, end, result);
+}
+
+void controller::getNotesNear(int lowPitch, int highPitch, double start, double end, vector<int>& result) {
+  if (livePlayState) {
+    getVisibleNotes(start, end, result);
+    return;
+  }
+  if (streamState) {
+    stream->findNotesNear(lowPitch, highPitch, start, end, result);
+    return;
+  }
+  file.findNotesNear(lowPitch, highPitch, start, end, result);
+}
+
+void controller::findVisibleLines(double start, double end, vector<int>& result) {
+  if (livePlayState) {
+    // segments are only kept for resident notes
+    if (store != &liveInput.noteStream.store) {
+      result.clear();
+      return;
+    }
+    liveInput.findVisibleLines(start, end, result);
+    return;
+  }
+  file.findVisibleLines(start, end, result);
+}
+
+vector<int>* controller::getLineVerts() {
+  return livePlayState ? liveInput.getLineVerts() : file.getLineVerts();
+}
+
 void controller::load(string filename) {
-  file.load(filename);
+  // opening another file abandons a load still in progress
+  loader.cancel();
+  output.stop();
+
+  if (!isMKI(filename) && isStreamable(filename)) {
+    // too large to hold in memory, prescanned in the background and paged in from disk as the view moves
+    loader.start(filename, getSheetSize(), true);
+    return;
+  }
+
+  if (isMKI(filename)) {
+    if (!mkiFile::load(filename, file, setTrackOn, setTrackOff)) {
+      return;
+    }
+    finishLoad(filename);
+    return;
+  }
+
+  // plain MIDI is parsed in the background, see update()
+  loader.start(filename, getSheetSize(), false);
+}
+
+void controller::update() {
+  if (!loader.isFinished()) {
+    return;
+  }
+  shared_ptr<loadJob> job = loader.take();
+  if (!job->success) {
+    return;
+  }
+
+  if (job->streamed) {
+    // opened on the side, so a failure has left the current file in view
+    stream.swap(job->stream);
+    file.clear();
+    bars.unload();
+    streamState = true;
+    store = livePlayState ? &liveInput.noteStream.store : &stream->store;
+    getColorScheme(stream->getTrackCount(), setTrackOn, setTrackOff, stream->trackHeightMap);
+    currentFile = job->filename;
+    return;
+  }
+
+  // vectors keep their buffers when moved, so note links stay valid
+  std::swap(file, job->file);
   getColorScheme(file.getTrackCount(), setTrackOn, setTrackOff, file.trackHeightMap);
+  finishLoad(job->filename);
+}
+
+void controller::shutdown() {
+  output.stop();
+  loader.shutdown();
+}
+
+void controller::finishLoad(string filename) {
+  if (streamState) {
+    stream->close();
+    streamState = false;
+    if (!livePlayState) {
+      store = &file.store;
+    }
+  }
+  bars.load(file.store);
+  currentFile = filename;
+}
+
+bool controller::save(string filename) {
+  if (livePlayState) {
+    // live sessions are kept as plain notes, so they go out as MIDI
+    if (filename.size() < 4 || filename.substr(filename.size() - 4) != ".mid") {
+      filename += ".mid";
+    }
+    return liveInput.save(filename);
+  }
+  if (streamState) {
+    logII(LL_WARN, "cannot save a streamed file");
+    return false;
+  }
+  if (!isMKI(filename)) {
+    filename += ".mki";
+  }
+  if (!mkiFile::save(filename, file, setTrackOn, setTrackOff)) {
+    return false;
+  }
+  currentFile = filename;
+  return true;
+}
+
+bool controller::exportImage(string filename, imageView view) {
+  if (livePlayState || streamState || isLoading()) {
+    logII(LL_WARN, "only loaded files can be exported");
+    return false;
+  }
+  if (filename.size() < 4 || filename.substr(filename.size() - 4) != ".png") {
+    filename += ".png";
+  }
+  return imageExport::save(filename, file, view);
+}
+
+void controller::playOutput(const transport& playback) {
+  // streamed files only keep a window of notes in memory
+  if (livePlayState || streamState || isLoading() || !output.isPortOpen()) {
+    return;
+  }
+  output.play(&file.store, playback);
 }
 
 void controller::loadTextures() {
@@ -2,15 +2,23 @@
 
 #include <vector>
 #include <functional>
+#include <memory>
 #include <raylib.h>
 #include "midi.h"
 #include "misc.h"
 #include "data.h"
 #include "input.h"
+#include "output.h"
 #include "color.h"
 #include "colorgen.h"
+#include "batch.h"
+#include "mki.h"
+#include "stream.h"
+#include "loader.h"
+#include "export.h"
 
 using std::vector;
+using std::unique_ptr;
 
 class controller {
   public:
@@ -19,8 +27,11 @@ class controller {
       programState = true;
       playState = false;
       livePlayState = false;
-      livePlayOffset = 0;
-      notes = &file.notes;
+      streamState = false;
+      viewWidth = 0;
+      viewHeight = 0;
+      store = &file.store;
+      stream.reset(new midiStream());
       
       getColorScheme(128, setVelocityOn, setVelocityOff);
       getColorScheme(12, setTonicOn, setTonicOff);
@@ -31,28 +42,52 @@ class controller {
     void toggleLivePlay();
     void setCloseFlag();
     void load(string filename);
+    void update();
+    // waits for background loads and playback, before main returns and the statics they use go away
+    void shutdown();
+    bool save(string filename);
+    bool exportImage(string filename, imageView view);
+    // sends the loaded file to the output port in step with playback, if one is open
+    void playOutput(const transport& playback);
     void loadTextures();
 
     bool getProgramState() { return programState; }
     bool getPlayState() { return playState; }
     bool getLiveState() { return livePlayState; }
+    bool getStreamState() { return streamState; }
+    bool isLoading() { return loader.isLoading(); }
+    float getLoadProgress() { return loader.getProgress(); }
+    string getLoadStage() { return loader.getStageName(); }
 
     int getTrackCount();
     int getNoteCount();
     int getLastTime();
     int getTempo(int idx);
 
-    int getWidth() { return GetScreenWidth(); }
-    int getHeight() { return GetScreenHeight(); }
-    point getSize() { return {GetScreenWidth(), GetScreenHeight()}; }
+    void getVisibleNotes(double start, double end, vector<int>& result);
+    void getNotesNear(int lowPitch, int highPitch, double start, double end, vector<int>& result);
+    // line mode segments, result holds segment numbers into getLineVerts
+    void findVisibleLines(double start, double end, vector<int>& result);
+    vector<int>* getLineVerts();
+
+    int getWidth() { return viewWidth ? viewWidth : GetScreenWidth(); }
+    int getHeight() { return viewHeight ? viewHeight : GetScreenHeight(); }
+    point getSize() { return {getWidth(), getHeight()}; }
+    // lays out for an offscreen target instead of the window, zero goes back to the window size
+    void setViewSize(int width, int height) { viewWidth = width; viewHeight = height; }
     point getMousePosition() { return (point){ GetMouseX(), GetMouseY()}; }
 
+    string getFilename() { return currentFile; }
+
     int getSheetSize() { return getWidth() - SHEET_LMARGIN - SHEET_RMARGIN; }
 
     midi file;
     midiInput liveInput;
+    midiOutput output;
+    barRenderer bars;
+    unique_ptr<midiStream> stream;
 
-    vector<note>* notes;
+    noteStore* store;
 
     vector<colorRGB> setTrackOn;
     vector<colorRGB> setTrackOff;
@@ -78,8 +113,6 @@ class controller {
     const int barWidth = 10;
     const int barSpacing = 80;
     const int barMargin = 49;
-
-    int livePlayOffset;
   
     Texture2D quarter;
     Texture2D half;
@@ -105,7 +138,15 @@ class controller {
     bool programState = true;
     bool playState;
     bool livePlayState;
-    
+    bool streamState;
+    string currentFile;
+
+    int viewWidth;
+    int viewHeight;
+
+    fileLoader loader;
+
+    void finishLoad(string filename);
 
 };
 
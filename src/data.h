@@ -15,6 +15,10 @@
 #define SHEET_NOTEWIDTH 20
 #define SHEET_RMARGIN 30
 #define SHEET_LMARGIN 80
+// sheet width of the default window, for loads that have no window to measure
+#define SHEET_DEFAULT_SIZE (mWidth - SHEET_LMARGIN - SHEET_RMARGIN)
+// measures of the next sheet page drawn ahead per frame
+#define SHEET_PREFETCH_STEPS 4
 
 enum colorSelections {
   SELECT_BG,
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <raylib.h>
+#include "export.h"
+#include "png.h"
+#include "pool.h"
+#include "wrap.h"
+#include "define.h"
+#include "log.h"
+
+using std::min;
+using std::max;
+using std::mutex;
+using std::condition_variable;
+using std::unique_lock;
+using std::lock_guard;
+
+// draws the part of the image at (x, y) into the current render target
+static void drawTile(midi& file, const imageView& view, int x, int y, int width, vector<int>& visible) {
+  float laneStep = view.height / float(NOTE_RANGE + 4);
+  double tileStart = view.start + (x - 1) / view.zoom;
+  double tileEnd = view.start + (x + width + 1) / view.zoom;
+
+  const auto imageX = [&] (double time) {
+    return static_cast<int>((time - view.start) * view.zoom) - x;
+  };
+  const auto imageY = [&] (int pitch) {
+    return static_cast<int>(view.height - laneStep * (pitch - MIN_NOTE_IDX + 3)) - y;
+  };
+  const auto colorOf = [&] (int i) {
+    int colorID = 0;
+    switch (view.colorMode) {
+      case COLOR_PART:
+        colorID = file.store.track[i];
+        break;
+      case COLOR_VELOCITY:
+        colorID = file.store.velocity[i];
+        break;
+      case COLOR_TONIC:
+        colorID = (file.store.pitch[i] - MIN_NOTE_IDX + view.tonic) % 12;
+        break;
+    }
+    return view.colors->at(min(max(colorID, 0), (int)view.colors->size() - 1));
+  };
+
+  clearBackground(view.background);
+
+  for (unsigned int i = max(file.findMeasure(tileStart) - 1, 0); i < file.measureMap.size(); i++) {
+    double location = file.measureMap[i].getLocation();
+    if (location > tileEnd) {
+      break;
+    }
+    drawLineEx(imageX(location), -y, imageX(location), view.height - y, 0.5, view.measure);
+  }
+
+  if (view.displayMode == DISPLAY_LINE) {
+    vector<int>& verts = *file.getLineVerts();
+    file.findVisibleLines(tileStart, tileEnd, visible);
+    for (unsigned int v = 0; v < visible.size(); v++) {
+      unsigned int j = visible[v] * 5;
+      drawLineEx(imageX(verts[j + 1]), imageY(verts[j + 2]), imageX(verts[j + 3]), imageY(verts[j + 4]), 2,
+                 colorOf(verts[j]));
+    }
+    return;
+  }
+
+  // the other modes depend on the now line, a poster shows every note as a bar
+  file.findVisibleNotes(tileStart, tileEnd, visible);
+  for (unsigned int v = 0; v < visible.size(); v++) {
+    int i = visible[v];
+    int noteY = imageY(file.store.pitch[i]);
+    if (noteY + laneStep < 0 || noteY > EXPORT_TILE_HEIGHT) {
+      continue;
+    }
+    drawRectangle(imageX(file.store.start[i]), noteY, max(file.store.duration[i] * view.zoom, 1.0), laneStep,
+                  colorOf(i));
+  }
+}
+
+bool imageExport::save(const string& filename, midi& file, imageView view) {
+  if (!file.store.size() || view.end <= view.start || view.height <= 0 || view.colors->empty()) {
+    logII(LL_WARN, "nothing to export");
+    return false;
+  }
+
+  double width = (view.end - view.start) * view.zoom;
+  if (width > EXPORT_MAX_WIDTH) {
+    logII(LL_WARN, "image too wide, reducing zoom");
+    view.zoom *= EXPORT_MAX_WIDTH / width;
+    width = EXPORT_MAX_WIDTH;
+  }
+  int imageWidth = max(static_cast<int>(width), 1);
+
+  pngWriter png;
+  if (!png.open(filename, imageWidth, view.height)) {
+    return false;
+  }
+
+  RenderTexture2D tile = LoadRenderTexture(EXPORT_TILE_WIDTH, EXPORT_TILE_HEIGHT);
+  vector<int> visible;
+
+  // two bands of packed RGB rows, one renders while the other encodes
+  vector<unsigned char> bands[2];
+  bands[0].resize(imageWidth * EXPORT_TILE_HEIGHT * 3);
+  bands[1].resize(imageWidth * EXPORT_TILE_HEIGHT * 3);
+
+  mutex lock;
+  condition_variable idle;
+  bool encoding = false;
+  bool encodeFailed = false;
+  bool success = true;
+
+  const auto waitForEncoder = [&] {
+    unique_lock<mutex> guard(lock);
+    idle.wait(guard, [&] { return !encoding; });
+    success = success && !encodeFailed;
+  };
+
+  for (int y = 0, band = 0; y < view.height && success; y += EXPORT_TILE_HEIGHT, band ^= 1) {
+    int bandHeight = min(EXPORT_TILE_HEIGHT, view.height - y);
+    unsigned char* rows = bands[band].data();
+
+    for (int x = 0; x < imageWidth; x += EXPORT_TILE_WIDTH) {
+      int tileWidth = min(EXPORT_TILE_WIDTH, imageWidth - x);
+
+      BeginTextureMode(tile);
+        drawTile(file, view, x, y, tileWidth, visible);
+      EndTextureMode();
+
+      // texture rows come back bottom up
+      Image pixels = GetTextureData(tile.texture);
+      if (pixels.data == nullptr) {
+        success = false;
+        break;
+      }
+      const unsigned char* data = static_cast<const unsigned char*>(pixels.data);
+      for (int r = 0; r < bandHeight; r++) {
+        const unsigned char* in = data + (EXPORT_TILE_HEIGHT - 1 - r) * EXPORT_TILE_WIDTH * 4;
+        unsigned char* out = rows + (r * imageWidth + x) * 3;
+        for (int c = 0; c < tileWidth; c++) {
+          out[c * 3] = in[c * 4];
+          out[c * 3 + 1] = in[c * 4 + 1];
+          out[c * 3 + 2] = in[c * 4 + 2];
+        }
+      }
+      UnloadImage(pixels);
+    }
+    if (!success) {
+      break;
+    }
+
+    // the previous band must be written before this one, and its buffer is reused next
+    waitForEncoder();
+    if (!success) {
+      break;
+    }
+    encoding = true;
+    getThreadPool().submit([&, rows, bandHeight] {
+      bool written = png.writeRows(rows, bandHeight);
+      lock_guard<mutex> guard(lock);
+      encodeFailed = encodeFailed || !written;
+      encoding = false;
+      idle.notify_all();
+    });
+  }
+
+  waitForEncoder();
+  UnloadRenderTexture(tile);
+
+  if (!png.close() || !success) {
+    logII(LL_WARN, "unable to export image: " + filename);
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "midi.h"
+#include "color.h"
+
+using std::string;
+using std::vector;
+
+// tiles are rendered into one reused texture, well under any GPU texture limit
+#define EXPORT_TILE_WIDTH 4096
+#define EXPORT_TILE_HEIGHT 128
+// widest image that will be written, the zoom is reduced to fit
+#define EXPORT_MAX_WIDTH (1 << 20)
+
+// what to draw, in the same units and colors as the main view
+struct imageView {
+  double start;
+  double end;
+  double zoom;
+  int height;
+  int displayMode;
+  int colorMode;
+  int tonic;
+  vector<colorRGB>* colors;
+  colorRGB background;
+  colorRGB measure;
+};
+
+// renders a time range of a file to a PNG of any width, a band of tiles at a time,
+// each band is encoded on the thread pool while the next one renders
+class imageExport {
+  public:
+    static bool save(const string& filename, midi& file, imageView view);
+};
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include "history.h"
+#include "log.h"
+
+using std::max;
+using std::min;
+
+bool noteLog::open() {
+  close();
+  file = tmpfile();
+  if (file == nullptr) {
+    logII(LL_WARN, "unable to create note log");
+    return false;
+  }
+  return true;
+}
+
+void noteLog::close() {
+  if (file != nullptr) {
+    fclose(file);
+  }
+  file = nullptr;
+  blocks.clear();
+  count = 0;
+  lastEnd = 0;
+}
+
+bool noteLog::append(noteStore& store, int notes, const vector<int>& skip) {
+  if (file == nullptr && !open()) {
+    return false;
+  }
+
+  vector<streamNote> records;
+  unsigned int s = 0;
+  for (int i = 0; i < notes; i++) {
+    if (s < skip.size() && skip[s] == i) {
+      s++;
+      continue;
+    }
+    records.push_back({store.start[i], float(max(store.duration[i], 0.0)), store.track[i], store.pitch[i],
+                       store.velocity[i]});
+  }
+
+  fseek(file, 0, SEEK_END);
+  if (fwrite(records.data(), sizeof(streamNote), records.size(), file) != records.size()) {
+    logII(LL_WARN, "unable to write note log");
+    return false;
+  }
+
+  for (unsigned int i = 0; i < records.size(); i++, count++) {
+    double end = records[i].start + records[i].duration;
+    if (count % LOG_BLOCK == 0) {
+      blocks.push_back({records[i].start, end});
+    }
+    blocks.back().first = min(blocks.back().first, records[i].start);
+    blocks.back().last = max(blocks.back().last, end);
+    lastEnd = max(lastEnd, end);
+  }
+  return true;
+}
+
+void noteLog::read(double start, double end, vector<streamNote>& result) {
+  result.clear();
+  if (file == nullptr) {
+    return;
+  }
+
+  streamNote buffer[LOG_BLOCK];
+  for (unsigned int b = 0; b < blocks.size(); b++) {
+    if (blocks[b].first > end || blocks[b].last < start) {
+      continue;
+    }
+    fseek(file, b * (long long)LOG_BLOCK * sizeof(streamNote), SEEK_SET);
+    size_t got = fread(buffer, sizeof(streamNote), LOG_BLOCK, file);
+    for (size_t j = 0; j < got; j++) {
+      if (buffer[j].start <= end && buffer[j].start + buffer[j].duration >= start) {
+        result.push_back(buffer[j]);
+      }
+    }
+  }
+}
+
+bool noteLog::forEach(const function<void(const streamNote&)>& fn) {
+  if (file == nullptr) {
+    return count == 0;
+  }
+
+  rewind(file);
+  streamNote buffer[LOG_BLOCK];
+  long long seen = 0;
+  size_t got;
+  while ((got = fread(buffer, sizeof(streamNote), LOG_BLOCK, file)) > 0) {
+    for (size_t j = 0; j < got; j++) {
+      fn(buffer[j]);
+    }
+    seen += got;
+  }
+  return seen == count;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdio>
+#include <functional>
+#include <vector>
+#include "store.h"
+#include "stream.h"
+
+using std::function;
+using std::vector;
+
+// records per index entry, scrollback reads whole blocks whose time range overlaps the view
+#define LOG_BLOCK 1024
+
+// append-only on-disk log of notes that scrolled out of memory, in the order they were spilled
+class noteLog {
+  public:
+    noteLog() {
+      blocks = {};
+      file = nullptr;
+      count = 0;
+      lastEnd = 0;
+    }
+    ~noteLog() {
+      close();
+    }
+
+    bool open();
+    void close();
+    bool isOpen() { return file != nullptr; }
+
+    // moves the first count notes of store to the end of the log, skipping the ascending indices in skip
+    bool append(noteStore& store, int count, const vector<int>& skip);
+    // logged notes sounding anywhere in [start, end], in log order
+    void read(double start, double end, vector<streamNote>& result);
+    // every logged note, notes held across a spill come after newer ones
+    bool forEach(const function<void(const streamNote&)>& fn);
+
+    long long size() { return count; }
+    // latest end of any logged note, views starting after it need nothing from the log
+    double getLastEnd() { return lastEnd; }
+
+  private:
+    // earliest start and latest end in a block, notes held across a spill keep blocks from being in order
+    struct logBlock {
+      double first;
+      double last;
+    };
+
+    vector<logBlock> blocks;
+    FILE* file;
+    long long count;
+    double lastEnd;
+};
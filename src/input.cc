@@ -1,37 +1,63 @@
 #include "input.h"
 #include "data.h"
-#include "controller.h"
-#include "define.h"
+#include "misc.h"
+#include <algorithm>
 
-midiInput::midiInput() : midiIn(nullptr), msgQueue(0), numPort(0), noteCount(0), numOn(0), timestamp(0) {
+using std::min;
+using std::max;
+using std::sort;
+using std::stable_sort;
+
+midiInput::midiInput() : midiIn(nullptr), dropped(0), msgQueue(0), horizon(LIVE_HORIZON), viewTime(-1), scrollStart(0),
+                         scrollEnd(0), scrollNotes(-1), scrollOn(0), lineVerts(0), lineFinal(0),
+                         lineSpan(0), lineOpen(0), numPort(0), noteCount(0), numOn(0), timestamp(0), offset(0) {
   midiIn = new RtMidiIn();
   if (midiIn == nullptr) {
     logII(LL_WARN, "unable to initialize midi input");
+    return;
+  }
+  for (int c = 0; c < 16; c++) {
+    for (int k = 0; k < 128; k++) {
+      activeNotes[c][k] = -1;
+    }
+  }
+
+  // messages arrive on RtMidi's thread as they are received instead of being polled once per frame
+  midiIn->setCallback(&midiInput::receive, this);
+}
+
+void midiInput::receive(double delta, vector<unsigned char>* message, void* userData) {
+  midiInput* input = static_cast<midiInput*>(userData);
+  inputMessage msg = {delta, 0, {0, 0, 0}};
+  msg.size = message->size() < 3 ? message->size() : 3;
+  for (int i = 0; i < msg.size; i++) {
+    msg.data[i] = message->at(i);
+  }
+  if (!input->received.push(msg)) {
+    input->dropped++;
   }
 }
 
 midiInput::~midiInput() {
+  if (midiIn != nullptr) {
+    midiIn->cancelCallback();
+  }
   delete midiIn;
 }
 
 void midiInput::openPort(int port) {
-  if (ctr.getLiveState()) {
-    midiIn->closePort();
-
-    numPort = midiIn->getPortCount();
-    if (port >= numPort) {
-      log3(LL_WARN, "unable to open port number", port);
-      return;
-    }
+  midiIn->closePort();
 
-    midiIn->openPort(port);
-    midiIn->ignoreTypes(false, false, false);
-    
-    log3(LL_INFO, "opened port ", port);
-  }
-  else {
-    logII(LL_WARN, "cannot open port in normal mode");
+  numPort = midiIn->getPortCount();
+  if (port >= numPort) {
+    log3(LL_WARN, "unable to open port number", port);
+    return;
   }
+
+  midiIn->openPort(port);
+  midiIn->ignoreTypes(false, false, false);
+  
+  log3(LL_INFO, "opened port ", port);
 }
 
 vector<string> midiInput::getPorts() {
@@ -58,7 +84,13 @@ vector<string> midiInput::getPorts() {
 }
 
 bool midiInput::updateQueue() {
-  timestamp = midiIn->getMessage(&msgQueue);
+  inputMessage msg;
+  if (!received.pop(msg)) {
+    msgQueue.clear();
+    return false;
+  }
+  timestamp = msg.delta;
+  msgQueue.assign(msg.data, msg.data + msg.size);
   for (long unsigned int i = 0; i < msgQueue.size(); i++) {
     if ((int)msgQueue[i] != 248 && (int)msgQueue[i] != 254){ 
       //cerr << "byte " << i << " is " << (int)msgQueue[i] << ", ";
@@ -75,79 +107,283 @@ bool midiInput::updateQueue() {
 }
 
 void midiInput::convertEvents() {
-  //-timestamp * 100 * noteStream->getTimeScale()
+  // every message moves the clock by its own delta, clock bytes (248) included,
+  // so notes keep their timing between clock ticks
+  offset += timestamp * LIVE_TIME_SCALE;
   for (long unsigned int i = 0; i < msgQueue.size(); i++) { 
-    if (msgQueue[i] == 0b11111000) { // 248: clock signal
-      //cerr << "shift by " << timestamp*100 << endl;
-      ctr.livePlayOffset += timestamp * 100;
-    }
-    else if (msgQueue[i] == 0b10010000) { // 144: note on/off
-      if (msgQueue[i + 2] != 0) { // if note on
-        note tmpNote;
-        tmpNote.track = 0; // by default
-        tmpNote.x = ctr.livePlayOffset;
-        tmpNote.y = static_cast<int>(msgQueue[i + 1]);
-        tmpNote.velocity = static_cast<int>(msgQueue[i + 2]);
-        tmpNote.isOn = true;
-        
-        // if this is the note on event, duration is undefined
-        tmpNote.duration = -1;
-        
-        noteStream.notes.push_back(tmpNote);
-        noteStream.tracks[0].insert(noteCount, &noteStream.notes.at(noteCount)); 
-        noteCount++;
-        numOn++;
-        i += 2;
-        
-        //cerr << "this note is: x, Y, Velocity:" << tmpNote.x << ", " << tmpNote.y << ", " << tmpNote.velocity << endl;
-        
-        noteStream.noteCount = noteCount;
+    int status = msgQueue[i] & 0xF0;
+    if ((status == 0b10010000 || status == 0b10000000) && i + 2 < msgQueue.size()) { // 144/128: note on/off
+      int channel = msgQueue[i] & 0x0F;
+      if (status == 0b10010000 && msgQueue[i + 2] != 0) { // if note on
+        noteOn(channel, msgQueue[i + 1] & 0x7F, msgQueue[i + 2]);
       }
       else {
-        int idx = findNoteIndex(static_cast<int>(msgQueue[i + 1]));
-        noteStream.notes[idx].isOn = false;
-        //note tmpNote = noteStream.notes[idx];
+        noteOff(channel, msgQueue[i + 1] & 0x7F);
+      }
+      i += 2;
+    }
+  }
+}
+
+void midiInput::noteOn(int channel, int key, int velocity) {
+  // a repeated key ends the note it was still holding
+  noteOff(channel, key);
 
-        numOn--;
+  // if this is the note on event, duration is undefined
+  int idx = noteStream.store.add(offset, -1, key, 0, velocity, channel);
+  noteStream.store.on[idx] = true;
 
-        //cerr << "this note is: x, Y, Velocity:" << tmpNote.x << ", " << tmpNote.y << ", " << tmpNote.velocity << endl;
+  // a new chord gives the previous one a target to draw lines to
+  int prev = noteStream.store.prev[idx];
+  if (prev != -1 && noteStream.store.start[prev] != noteStream.store.start[idx]) {
+    lineOpen.push_back(prev);
+  }
+
+  activeNotes[channel][key] = idx;
+  heldSlot.resize(idx + 1, -1);
+  heldSlot[idx] = heldNotes.size();
+  heldNotes.push_back(idx);
+
+  noteCount++;
+  numOn++;
+  noteStream.noteCount = noteCount;
+
+  if (noteCount > horizon) {
+    spill();
+  }
+}
+
+void midiInput::spill() {
+  // held notes are still growing, they stay resident and move to the front while the rest go,
+  // so a stuck note only costs its own slot
+  int count = min(horizon / 4, noteStream.store.size());
+  vector<int> keep;
+  for (unsigned int i = 0; i < heldNotes.size(); i++) {
+    if (heldNotes[i] < count) {
+      keep.push_back(heldNotes[i]);
+    }
+  }
+  sort(keep.begin(), keep.end());
+  if (count <= (int)keep.size() || !history.append(noteStream.store, count, keep)) {
+    return;
+  }
+
+  vector<int> remap;
+  noteStream.store.eraseFront(count, keep, remap);
+  for (int c = 0; c < 16; c++) {
+    for (int k = 0; k < 128; k++) {
+      if (activeNotes[c][k] != -1) {
+        activeNotes[c][k] = remap[activeNotes[c][k]];
+      }
+    }
+  }
+  heldSlot.assign(noteStream.store.size(), -1);
+  for (unsigned int i = 0; i < heldNotes.size(); i++) {
+    heldNotes[i] = remap[heldNotes[i]];
+    heldSlot[heldNotes[i]] = i;
+  }
+
+  // segments of spilled chords go with them, the rest keep their order since remap keeps start order
+  int kept = 0;
+  for (int i = 0; i < lineFinal; i += 5) {
+    if (remap[lineVerts[i]] != -1) {
+      for (int j = 0; j < 5; j++) {
+        lineVerts[kept + j] = lineVerts[i + j];
       }
+      lineVerts[kept] = remap[lineVerts[i]];
+      kept += 5;
+    }
+  }
+  lineVerts.resize(kept);
+  lineFinal = kept;
+  kept = 0;
+  for (unsigned int i = 0; i < lineOpen.size(); i++) {
+    if (remap[lineOpen[i]] != -1) {
+      lineOpen[kept++] = remap[lineOpen[i]];
+    }
+  }
+  lineOpen.resize(kept);
+
+  noteCount = noteStream.store.size();
+  noteStream.noteCount = noteCount;
+}
+
+noteStore* midiInput::getViewStore(double start, double end) {
+  if (viewTime < 0 || !history.size() || start > history.getLastEnd()) {
+    return &noteStream.store;
+  }
+  if (start == scrollStart && end == scrollEnd && scrollNotes == noteCount + history.size() && scrollOn == numOn) {
+    return &scrollback;
+  }
+  scrollStart = start;
+  scrollEnd = end;
+  scrollNotes = noteCount + history.size();
+  scrollOn = numOn;
+
+  vector<streamNote> notes;
+  history.read(start, end, notes);
+  // held notes have no duration yet and count as sounding until the live clock
+  noteStore& store = noteStream.store;
+  for (int i = 0; i < noteCount; i++) {
+    double duration = store.on[i] ? offset - store.start[i] : store.duration[i];
+    if (store.start[i] <= end && store.start[i] + duration >= start) {
+      notes.push_back({store.start[i], float(store.duration[i]), store.track[i], store.pitch[i],
+                       uint8_t(store.velocity[i] | (store.on[i] ? 0x80 : 0))});
     }
   }
+  stable_sort(notes.begin(), notes.end(), [](const streamNote& left, const streamNote& right) {
+    return left.start < right.start;
+  });
+
+  scrollback.clear();
+  scrollback.reserve(notes.size());
+  for (unsigned int i = 0; i < notes.size(); i++) {
+    int idx = scrollback.add(notes[i].start, notes[i].duration, notes[i].key, notes[i].track, notes[i].velocity & 0x7F);
+    scrollback.on[idx] = notes[i].velocity >> 7;
+  }
+  return &scrollback;
+}
+
+bool midiInput::save(const string& filename) {
+  // at the default 120 bpm a quarter is half a second, the live clock runs LIVE_TIME_SCALE units per second
+  const int tpq = 480;
+  const double ticksPerUnit = 2.0 * tpq / LIVE_TIME_SCALE;
+  MidiFile out;
+  out.setTicksPerQuarterNote(tpq);
+
+  const auto addNote = [&] (double start, double duration, int key, int velocity) {
+    int tick = max(static_cast<int>(start * ticksPerUnit), 0);
+    out.addNoteOn(0, tick, 0, key, velocity);
+    out.addNoteOff(0, tick + max(static_cast<int>(duration * ticksPerUnit), 1), 0, key, 0);
+  };
+
+  bool complete = history.forEach([&] (const streamNote& n) {
+    addNote(n.start, n.duration, n.key, n.velocity & 0x7F);
+  });
+  for (int i = 0; i < noteCount; i++) {
+    addNote(noteStream.store.start[i], noteStream.store.duration[i], noteStream.store.pitch[i], noteStream.store.velocity[i]);
+  }
+  if (!complete) {
+    logII(LL_WARN, "note log could not be read back in full");
+  }
+
+  out.sortTracks();
+  if (!out.write(filename)) {
+    logII(LL_WARN, "unable to save live session: " + filename);
+    return false;
+  }
+  return true;
+}
+
+void midiInput::noteOff(int channel, int key) {
+  int idx = activeNotes[channel][key];
+  if (idx == -1) {
+    return;
+  }
+  activeNotes[channel][key] = -1;
+  noteStream.store.on[idx] = false;
+  noteStream.store.duration[idx] = offset - noteStream.store.start[idx];
+
+  int last = heldNotes.back();
+  heldNotes[heldSlot[idx]] = last;
+  heldSlot[last] = heldSlot[idx];
+  heldNotes.pop_back();
+  heldSlot[idx] = -1;
+
+  numOn--;
 }
 
 void midiInput::updatePosition() {
-  int i = 0;
-  for (int j = noteCount - 1; j >= 0; j--) {
-    if (i >= numOn) {
-      // all on notes shifted
-      break;
+  // only held notes grow, however long the session
+  for (unsigned int i = 0; i < heldNotes.size(); i++) {
+    int j = heldNotes[i];
+    noteStream.store.duration[j] = offset - noteStream.store.start[j];
+  }
+}
+
+void midiInput::updateLines() {
+  noteStore& store = noteStream.store;
+  lineVerts.resize(lineFinal);
+
+  // a chord is done once none of it is held and the chord after it has been followed by another
+  int open = 0;
+  for (unsigned int i = 0; i < lineOpen.size(); i++) {
+    int root = lineOpen[i];
+    int target = store.next[root];
+    bool done = store.next[target] != -1;
+    for (int p = root; p != -1 && done; p = store.chordNext[p]) {
+      done = !store.on[p];
+    }
+    if (!done) {
+      lineOpen[open++] = root;
+      continue;
     }
-    if (noteStream.notes[j].isOn) {
-      noteStream.notes[j].duration = ctr.livePlayOffset - noteStream.notes[j].x;
-      i++;
+
+    vector<int> verts = getLinePositions(store, root, target);
+    if (verts.empty()) {
+      continue;
+    }
+    // roots mostly finish in order, so this lands at or near the end
+    int at = lineFinal;
+    while (at > 0 && lineVerts[at - 4] > verts[1]) {
+      at -= 5;
+    }
+    lineVerts.insert(lineVerts.begin() + at, verts.begin(), verts.end());
+    lineFinal += verts.size();
+    for (unsigned int j = 0; j < verts.size(); j += 5) {
+      lineSpan = max(lineSpan, double(verts[j + 3] - verts[j + 1]));
     }
   }
+  lineOpen.resize(open);
+
+  for (unsigned int i = 0; i < lineOpen.size(); i++) {
+    vector<int> verts = getLinePositions(store, lineOpen[i], store.next[lineOpen[i]]);
+    lineVerts.insert(lineVerts.end(), verts.begin(), verts.end());
+  }
 }
 
-int midiInput::findNoteIndex(int key) {
-  for (int i = noteCount - 1; i >= 0; i--) {
-    if (noteStream.notes[i].y == key) {
-      return i;
+void midiInput::findVisibleLines(double start, double end, vector<int>& result) {
+  result.clear();
+
+  // finished segments are sorted by start, none reaches further back than lineSpan
+  int low = 0;
+  int high = lineFinal / 5;
+  while (low < high) {
+    int mid = (low + high) / 2;
+    if (lineVerts[mid * 5 + 1] < start - lineSpan) {
+      low = mid + 1;
+    }
+    else {
+      high = mid;
     }
   }
-  return 0;
+  for (int i = low; i < lineFinal / 5 && lineVerts[i * 5 + 1] <= end; i++) {
+    if (lineVerts[i * 5 + 3] >= start) {
+      result.push_back(i);
+    }
+  }
+
+  // the few open segments are always drawn
+  for (int i = lineFinal / 5; i < (int)lineVerts.size() / 5; i++) {
+    result.push_back(i);
+  }
 }
 
-void midiInput::update() {
-  if (midiIn->isPortOpen()) {
-    while (updateQueue()) {
-      convertEvents();
-      updatePosition();
-    }
+void midiInput::update(double elapsed) {
+  int lost = dropped.exchange(0);
+  if (lost) {
+    log3(LL_WARN, "midi input ring full, messages dropped:", lost);
   }
-  else {
+
+  // messages come from an open port or from whoever calls receive directly
+  while (updateQueue()) {
+    convertEvents();
+    updatePosition();
+  }
+  if (!midiIn->isPortOpen()) {
     // shift even when midi input is disconnected
-    ctr.livePlayOffset += GetFrameTime();
+    offset += elapsed * LIVE_TIME_SCALE;
   }
+
+  updateLines();
 }
@@ -1,15 +1,34 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include "../dpd/rtmidi/RtMidi.h"
 #include "note.h"
 #include "midi.h"
+#include "ring.h"
+#include "history.h"
 #include "log.h"
 
 using std::vector;
 using std::string;
 using std::to_string;
+using std::atomic;
+
+// messages waiting between the RtMidi thread and the render loop
+#define INPUT_RING_SIZE 4096
+// live clock units per second of input
+#define LIVE_TIME_SCALE 100
+// live notes kept in memory before the oldest are moved to the note log
+#define LIVE_HORIZON (1 << 16)
+
+// one received message, only the first three bytes are kept since nothing longer is used
+struct inputMessage {
+  double delta;
+  uint8_t size;
+  uint8_t data[3];
+};
 
 class midiInput {
   public:
@@ -17,24 +36,82 @@ class midiInput {
     ~midiInput();
 
     void openPort(int port);
-    void update();
+    // drains received messages, elapsed (seconds) moves the clock on while no port is open
+    void update(double elapsed);
+
+    // live notes are stamped with this clock, LIVE_TIME_SCALE units per second where file time runs 500
+    double getOffset() { return offset; }
+    void advance(double time) { offset += time; }
     
     int getNoteCount() { return noteCount; }
     vector<string> getPorts();
 
+    // most notes kept in memory, older ones are spilled to disk a quarter of the horizon at a time
+    void setHorizon(int notes) { horizon = notes > 4 ? notes : 4; }
+    long long getSpilledCount() { return history.size(); }
+
+    // moves the view back through the session, anywhere at or past the live clock follows it again
+    void scrollTo(double time) { viewTime = time < offset ? (time > 0 ? time : 0) : -1; }
+    double getViewTime() { return viewTime < 0 ? offset : viewTime; }
+    // the notes to draw for [start, end], the live store unless the view reaches spilled notes, then a
+    // copy holding the ones read back from the log along with the resident ones in range
+    noteStore* getViewStore(double start, double end);
+    // writes the whole session, spilled and resident, as a MIDI file
+    bool save(const string& filename);
+
+    // line mode segments in groups of 5 like midi::getLineVerts, result holds segment numbers
+    vector<int>* getLineVerts() { return &lineVerts; }
+    void findVisibleLines(double start, double end, vector<int>& result);
+
+    // runs on the RtMidi thread, or on any single thread feeding messages without a port
+    static void receive(double delta, vector<unsigned char>* message, void* userData);
+
     midi noteStream;
 
   private:
+
     void convertEvents();
     void updatePosition();
     bool updateQueue();
-    int findNoteIndex(int key);
+    void noteOn(int channel, int key, int velocity);
+    void noteOff(int channel, int key);
+    void spill();
+    void updateLines();
     
     RtMidiIn* midiIn;
+    spscRing<inputMessage, INPUT_RING_SIZE> received;
+    atomic<int> dropped;
     vector<unsigned char> msgQueue;
+
+    // sounding note per (channel, key), -1 when silent
+    int activeNotes[16][128];
+    // notes still held, heldSlot is each note's position in it so removal is a swap with the last
+    vector<int> heldNotes;
+    vector<int> heldSlot;
+
+    noteLog history;
+    int horizon;
+
+    // where a scrolled back view sits, -1 while following the live clock
+    double viewTime;
+    // notes in view while scrolled back past the resident ones, rebuilt when the window or session changes
+    noteStore scrollback;
+    double scrollStart;
+    double scrollEnd;
+    long long scrollNotes;
+    int scrollOn;
+
+    // finished segments sorted by start, then the segments of lineOpen rebuilt on every update
+    vector<int> lineVerts;
+    int lineFinal;
+    double lineSpan;
+    // chord roots whose segments may still change, the chord is held or the next one is incomplete
+    vector<int> lineOpen;
+
     int numPort;
     int noteCount;
     int numOn;
     double timestamp;
+    double offset;
 
 };
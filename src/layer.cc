@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <rlgl.h>
+#include "layer.h"
+#include "profile.h"
+
+using std::min;
+
+layerKey& layerKey::mix(const void* data, size_t size) {
+  // FNV-1a
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return *this;
+}
+
+void renderLayer::update(int layerX, int layerY, int w, int h, uint64_t newKey, const function<void()>& fn) {
+  build(layerX, layerY, w, h, newKey, 1, 1, [&] (int, int) { fn(); });
+}
+
+bool renderLayer::build(int layerX, int layerY, int w, int h, uint64_t newKey, int steps, int budget,
+                        const function<void(int, int)>& fn) {
+  if (w <= 0 || h <= 0) {
+    return false;
+  }
+  x = layerX;
+  y = layerY;
+
+  if (valid && newKey == key && w == width && h == height) {
+    return true;
+  }
+
+  // anything but the continuation of the same build starts over on a cleared texture
+  if (!built || newKey != buildKey || w != width || h != height) {
+    if (w != width || h != height) {
+      if (target.id) {
+        UnloadRenderTexture(target);
+      }
+      target = LoadRenderTexture(w, h);
+      width = w;
+      height = h;
+    }
+    valid = false;
+    built = 0;
+    buildKey = newKey;
+  }
+
+  int end = budget > 0 ? min(built + budget, steps) : steps;
+  BeginTextureMode(target);
+    if (!built) {
+      ClearBackground({0, 0, 0, 0});
+    }
+    rlPushMatrix();
+    rlTranslatef(-x, -y, 0);
+    fn(built, end);
+    rlPopMatrix();
+  EndTextureMode();
+
+  built = end;
+  if (built >= steps) {
+    key = newKey;
+    valid = true;
+    built = 0;
+  }
+  return valid;
+}
+
+void renderLayer::draw() {
+  if (!valid) {
+    return;
+  }
+  // render textures are stored upside down
+  profiler.count(COUNT_DRAWCALLS);
+  DrawTextureRec(target.texture, {0, 0, float(width), float(-height)}, {float(x), float(y)}, WHITE);
+}
+
+void renderLayer::unload() {
+  if (target.id) {
+    UnloadRenderTexture(target);
+  }
+  target = {};
+  width = 0;
+  height = 0;
+  valid = false;
+  built = 0;
+}
+
+layerCache::slot& layerCache::find(int id) {
+  slot* found = &slots[0];
+  for (unsigned int i = 0; i < slots.size(); i++) {
+    if (slots[i].id == id) {
+      found = &slots[i];
+      break;
+    }
+    if (slots[i].used < found->used) {
+      found = &slots[i];
+    }
+  }
+
+  if (found->id != id) {
+    found->id = id;
+    found->layer.invalidate();
+  }
+  found->used = ++clock;
+  return *found;
+}
+
+renderLayer& layerCache::update(int id, int layerX, int layerY, int w, int h, uint64_t key, const function<void()>& fn) {
+  renderLayer& layer = find(id).layer;
+  layer.update(layerX, layerY, w, h, key, fn);
+  return layer;
+}
+
+renderLayer& layerCache::build(int id, int layerX, int layerY, int w, int h, uint64_t key, int steps, int budget,
+                               const function<void(int, int)>& fn) {
+  renderLayer& layer = find(id).layer;
+  layer.build(layerX, layerY, w, h, key, steps, budget, fn);
+  return layer;
+}
+
+bool layerCache::isCurrent(int id, uint64_t key, int w, int h) {
+  for (unsigned int i = 0; i < slots.size(); i++) {
+    if (slots[i].id == id) {
+      return slots[i].layer.isCurrent(key, w, h);
+    }
+  }
+  return false;
+}
+
+void layerCache::unload() {
+  for (unsigned int i = 0; i < slots.size(); i++) {
+    slots[i].layer.unload();
+    slots[i].id = -1;
+  }
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <raylib.h>
+#include "color.h"
+
+using std::function;
+using std::string;
+using std::vector;
+
+// hash of everything a cached layer depends on
+class layerKey {
+  public:
+    layerKey() {
+      hash = 14695981039346656037ull;
+    }
+
+    layerKey& add(int value) { return mix(&value, sizeof(value)); }
+    layerKey& add(double value) { return mix(&value, sizeof(value)); }
+    layerKey& add(const string& value) { add(int(value.size())); return mix(value.data(), value.size()); }
+    layerKey& add(const colorRGB& value) { return add(value.r).add(value.g).add(value.b); }
+
+    uint64_t get() { return hash; }
+
+  private:
+    layerKey& mix(const void* data, size_t size);
+
+    uint64_t hash;
+};
+
+// offscreen copy of drawing that rarely changes, redrawn only when its key does
+class renderLayer {
+  public:
+    renderLayer() {
+      target = {};
+      key = 0;
+      x = 0;
+      y = 0;
+      width = 0;
+      height = 0;
+      valid = false;
+      built = 0;
+      buildKey = 0;
+    }
+
+    // fn draws in screen coordinates, only the (x, y, w, h) box is kept
+    // must not be called while another render texture is bound
+    void update(int layerX, int layerY, int w, int h, uint64_t newKey, const function<void()>& fn);
+    // same as update for drawing split into steps, fn(begin, end) draws steps [begin, end) and
+    // at most budget of them run per call, the layer is valid once all steps are drawn
+    // returns whether it is valid
+    bool build(int layerX, int layerY, int w, int h, uint64_t newKey, int steps, int budget,
+               const function<void(int, int)>& fn);
+    // composites the layer where it was drawn
+    void draw();
+    void unload();
+
+    void invalidate() { valid = false; built = 0; }
+    bool isCurrent(uint64_t checkKey, int w, int h) { return valid && key == checkKey && width == w && height == h; }
+
+  private:
+    RenderTexture2D target;
+    uint64_t key;
+    int x;
+    int y;
+    int width;
+    int height;
+    bool valid;
+    // steps drawn so far of an unfinished build for buildKey
+    int built;
+    uint64_t buildKey;
+};
+
+// a few layers looked up by id, the least recently used one is recycled
+class layerCache {
+  public:
+    layerCache(int capacity = 3) {
+      slots.resize(capacity);
+      clock = 0;
+    }
+
+    // same as renderLayer::update and build on the layer kept for id
+    renderLayer& update(int id, int layerX, int layerY, int w, int h, uint64_t key, const function<void()>& fn);
+    renderLayer& build(int id, int layerX, int layerY, int w, int h, uint64_t key, int steps, int budget,
+                       const function<void(int, int)>& fn);
+    bool isCurrent(int id, uint64_t key, int w, int h);
+    void unload();
+
+  private:
+    struct slot {
+      int id = -1;
+      long long used = 0;
+      renderLayer layer;
+    };
+
+    // the slot kept for id, or the least recently used one handed over to it
+    slot& find(int id);
+
+    vector<slot> slots;
+    long long clock;
+};
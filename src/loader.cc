@@ -0,0 +1,93 @@
+#include "loader.h"
+
+using std::make_shared;
+
+void fileLoader::start(string filename, int sheetSize, bool streamed) {
+  cancel();
+
+  job = make_shared<loadJob>();
+  job->filename = filename;
+  job->sheetSize = sheetSize;
+  job->streamed = streamed;
+  job->done = false;
+  job->success = false;
+
+  // the thread keeps its own reference, a cancelled job is freed when it returns
+  shared_ptr<loadJob> worker = job;
+  runner = thread([worker]() {
+    if (worker->streamed) {
+      worker->stream.reset(new midiStream());
+      worker->success = worker->stream->open(worker->filename, &worker->progress);
+    }
+    else {
+      worker->success = worker->file.load(worker->filename, worker->sheetSize, &worker->progress);
+    }
+    worker->done = true;
+  });
+}
+
+void fileLoader::cancel() {
+  if (job != nullptr) {
+    job->progress.cancel = true;
+    abandoned.push_back({job, std::move(runner)});
+    job = nullptr;
+  }
+  reap();
+}
+
+void fileLoader::shutdown() {
+  cancel();
+  for (unsigned int i = 0; i < abandoned.size(); i++) {
+    abandoned[i].runner.join();
+  }
+  abandoned.clear();
+}
+
+void fileLoader::reap() {
+  for (unsigned int i = 0; i < abandoned.size(); ) {
+    if (abandoned[i].job->done) {
+      abandoned[i].runner.join();
+      abandoned.erase(abandoned.begin() + i);
+      continue;
+    }
+    i++;
+  }
+}
+
+shared_ptr<loadJob> fileLoader::take() {
+  shared_ptr<loadJob> result = job;
+  job = nullptr;
+  if (runner.joinable()) {
+    runner.join();
+  }
+  reap();
+  return result;
+}
+
+float fileLoader::getProgress() {
+  if (job == nullptr) {
+    return 0;
+  }
+  // a prescan only reads the file and spills its notes
+  int stages = job->streamed ? LOAD_NOTES + 1 : LOAD_STAGE_COUNT;
+  return (job->progress.stage + job->progress.fraction) / stages;
+}
+
+string fileLoader::getStageName() {
+  if (job == nullptr) {
+    return "";
+  }
+  switch (job->progress.stage) {
+    case LOAD_PARSE:
+      return job->streamed ? "Scanning file" : "Parsing file";
+    case LOAD_NOTES:
+      return job->streamed ? "Spilling notes" : "Extracting notes";
+    case LOAD_MEASURES:
+      return "Building measures";
+    case LOAD_LAYOUT:
+      return "Laying out sheet";
+    case LOAD_LINES:
+      return "Building lines";
+  }
+  return "";
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "midi.h"
+#include "stream.h"
+#include "progress.h"
+
+using std::atomic;
+using std::shared_ptr;
+using std::unique_ptr;
+using std::string;
+using std::thread;
+using std::vector;
+
+// one load in flight, owned jointly by the loader and its thread
+struct loadJob {
+  string filename;
+  int sheetSize;
+  // files too large to hold are prescanned into stream instead of parsed into file
+  bool streamed;
+  midi file;
+  unique_ptr<midiStream> stream;
+  loadProgress progress;
+  atomic<bool> done;
+  bool success;
+};
+
+// parses MIDI files on a worker thread so the window keeps rendering
+class fileLoader {
+  public:
+    fileLoader() {
+      job = nullptr;
+      abandoned.clear();
+    }
+    ~fileLoader() {
+      shutdown();
+    }
+
+    // abandons any load in flight
+    void start(string filename, int sheetSize, bool streamed);
+    // a cancelled thread winds down on its own and is joined once done
+    void cancel();
+    // cancels and waits for every thread, before anything they use is torn down
+    void shutdown();
+
+    bool isLoading() { return job != nullptr; }
+    bool isFinished() { return job != nullptr && job->done; }
+
+    // hands over a finished job, the loader is idle afterwards
+    shared_ptr<loadJob> take();
+
+    float getProgress();
+    string getStageName();
+
+  private:
+    struct loadWorker {
+      shared_ptr<loadJob> job;
+      thread runner;
+    };
+
+    // joins the cancelled threads that have returned
+    void reap();
+
+    shared_ptr<loadJob> job;
+    thread runner;
+    vector<loadWorker> abandoned;
+};
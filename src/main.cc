@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <chrono>
 #include <algorithm>
 #include <raylib.h>
 #include "box.h"
@@ -13,7 +14,12 @@
 #include "color.h"
 #include "define.h"
 #include "menuctr.h"
+#include "layer.h"
 #include "controller.h"
+#include "render.h"
+#include "transport.h"
+#include "profile.h"
+#include "stats.h"
 #include "../dpd/osdialog/osdialog.h"
 
 using std::cerr;
@@ -24,9 +30,12 @@ using std::vector;
 using std::ifstream;
 using std::min;
 using std::max;
+using std::equal;
 using std::to_string;
 using std::thread;
 using std::ref;
+using std::this_thread::sleep_for;
+using std::chrono::milliseconds;
 
 controller ctr;
 Font font;
@@ -39,10 +48,25 @@ int main (int argc, char* argv[]) {
    * * * * *
    */ 
   
+  // load statistics only need the parser, so they are written without opening a window
+  string statsInput;
+  string statsOutput;
+  if (parseStatsArgs(argc, argv, statsInput, statsOutput)) {
+    midi statsFile;
+    if (!statsFile.load(statsInput, SHEET_DEFAULT_SIZE)) {
+      return 1;
+    }
+    return statsFile.getLoadStats().saveJSON(statsOutput, statsInput) ? 0 : 1;
+  }
+
+  // offline rendering draws into a texture behind a hidden window, as fast as frames can be written
+  renderSettings render = {};
+  bool rendering = parseRenderArgs(argc, argv, render);
+
   SetTraceLogLevel(LOG_NONE);
-  SetConfigFlags(FLAG_MSAA_4X_HINT);
+  SetConfigFlags(rendering ? FLAG_WINDOW_HIDDEN : FLAG_MSAA_4X_HINT);
   InitWindow(mWidth, mHeight, (string("kelumi ") + string(mVersion)).c_str());
-  SetTargetFPS(60);
+  SetTargetFPS(rendering ? 0 : 60);
   font = LoadFontEx("bin/fonts/yklight.ttf", 14, 0, 250);
   ctr.loadTextures();
   
@@ -59,11 +83,13 @@ int main (int argc, char* argv[]) {
   const double shiftC = 2.5;
 
   // play settings
-  bool run = false;
+  transport playback;
 
   // view settings
   bool nowLine = true;
   bool showFPS = false;
+  bool showProfiler = false;
+  bool showLoadStats = false;
   bool colorMove = false;
   bool colorSquare = false;
   bool colorCircle = false;
@@ -73,6 +99,21 @@ int main (int argc, char* argv[]) {
   int tonicOffset = 0;
   int displayMode = DISPLAY_BAR;
   
+  // offline render state
+  RenderTexture2D renderTarget = {};
+  frameWriter renderWriter;
+  long long renderFrame = 0;
+  long long renderFrames = 0;
+
+  if (rendering) {
+    ctr.setViewSize(render.width, render.height);
+    renderTarget = LoadRenderTexture(render.width, render.height);
+    if (!renderWriter.open(render)) {
+      rendering = false;
+      ctr.setCloseFlag();
+    }
+  }
+
   float nowLineX = ctr.getWidth()/2.0f;
 
   string FPSText = "";
@@ -91,6 +132,19 @@ int main (int argc, char* argv[]) {
   osdialog_filters* savetypes = osdialog_filters_parse("mki:mki");
   osdialog_filters* imagetypes = osdialog_filters_parse("png:png");
 
+  // culling variables
+  const int cullMargin = 32;
+  vector<int> visibleNotes;
+  vector<int> visibleLines;
+
+  // hover picking variables
+  const float pickBallReach = 64;
+  vector<int> pickCandidates;
+  vector<int> hoverLine;
+  pickState lastPick = {};
+  int hoverNote = -1;
+  bool hoverOn = false;
+
   // right click variables
   int clickNote = -1;
   int clickTmp = -1;
@@ -100,6 +154,9 @@ int main (int argc, char* argv[]) {
   // menu controller
   menuController menuctr = menuController();
 
+  // cached static drawing, the current sheet page and the ones either side of it
+  layerCache sheetPages(3);
+
   // sheet music data
   //SetTextureFilter(bass, FILTER_ANISOTROPIC_16X);
 
@@ -117,7 +174,8 @@ int main (int argc, char* argv[]) {
   };
 
   // menu objects
-  vector<string> fileMenuContents = {"File", "Open File", "Open Image", "Save", "Save As", "Exit"};
+  vector<string> fileMenuContents = {"File", "Open File", "Open Image", "Save", "Save As", "Export Image",
+                                       "Load Statistics", "Exit"};
   menu fileMenu(ctr.getSize(), fileMenuContents, nullptr, TYPE_MAIN, menuctr.getOffset(), 0);
   menuctr.registerMenu(&fileMenu);
    
@@ -125,7 +183,8 @@ int main (int argc, char* argv[]) {
   menu editMenu(ctr.getSize(), editMenuContents, nullptr, TYPE_MAIN, menuctr.getOffset(), 0);
   menuctr.registerMenu(&editMenu);
   
-  vector<string> viewMenuContents = {"View", "Display Mode:", "Display Song Time:", "Hide Now Line", "Show Background", "Show FPS"};
+  vector<string> viewMenuContents = {"View", "Display Mode:", "Display Song Time:", "Hide Now Line", "Show Background", "Show FPS",
+                                       "Show Profiler", "Record Profile"};
   menu viewMenu(ctr.getSize(), viewMenuContents, nullptr, TYPE_MAIN, menuctr.getOffset(), 0);
   menuctr.registerMenu(&viewMenu);
   
@@ -145,6 +204,10 @@ int main (int argc, char* argv[]) {
   menu inputMenu(ctr.getSize(), inputMenuContents, &midiMenu, TYPE_SUB, midiMenu.getX() + midiMenu.getWidth(), midiMenu.getItemY(1));
   menuctr.registerMenu(&inputMenu);
 
+  vector<string> outputMenuContents = {""};
+  menu outputMenu(ctr.getSize(), outputMenuContents, &midiMenu, TYPE_SUB, midiMenu.getX() + midiMenu.getWidth(), midiMenu.getItemY(2));
+  menuctr.registerMenu(&outputMenu);
+
   vector<string> colorMenuContents = {"Color", "Color By:", "Color Scheme:", "Swap Colors", "Invert Color Scheme"};
   menu colorMenu(ctr.getSize(), colorMenuContents, nullptr, TYPE_MAIN, menuctr.getOffset(), 0);
   menuctr.registerMenu(&colorMenu);
@@ -171,7 +234,10 @@ int main (int argc, char* argv[]) {
    * * * * * 
    */
 
-  if (argc == 2) {
+  if (rendering) {
+    ctr.load(render.input);
+  }
+  else if (argc == 2) {
     string filename = argv[1];
     transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
     string ext = filename.substr(filename.size() - 3);
@@ -187,19 +253,57 @@ int main (int argc, char* argv[]) {
   }
   
   while (ctr.getProgramState()) {
-
     if (newFile) {
       newFile = false;
-      run = false;
+      playback.pause();
+      playback.seek(0);
       timeOffset = 0;
 
       ctr.load(filename);
     }
+
+    // pick up a finished background load
+    ctr.update();
+
+    // offline rendering waits for the file outside any frame, so every profiled frame is ended
+    if (rendering && ctr.isLoading()) {
+      sleep_for(milliseconds(10));
+      continue;
+    }
+
+    profiler.beginFrame();
+
+    // offline rendering steps time by whole frames once the file is in
+    if (rendering) {
+      if (!renderFrames) {
+        if (!ctr.getNoteCount()) {
+          logII(LL_WARN, "nothing to render in " + render.input);
+          break;
+        }
+        renderFrames = static_cast<long long>(ctr.getLastTime()) * render.fps / 500 + 1;
+      }
+      if (renderFrame >= renderFrames) {
+        break;
+      }
+      timeOffset = renderFrame * 500.0 / render.fps;
+    }
     
     if (ctr.getLiveState()) {
-      timeOffset = ctr.livePlayOffset;
-      ctr.liveInput.update();
-      run = false;
+      timeOffset = ctr.liveInput.getViewTime();
+      {
+        profileScope scope(PHASE_INPUT);
+        ctr.liveInput.update(GetFrameTime());
+      }
+      playback.pause();
+    }
+    else if (playback.isRunning() && !rendering) {
+      // sampled once per frame, the position never depends on how long frames take
+      timeOffset = playback.getTime();
+      if (timeOffset >= ctr.getLastTime()) {
+        timeOffset = ctr.getLastTime();
+        playback.pause();
+        playback.seek(timeOffset);
+      }
     }
 
     // fix FPS count bug
@@ -211,21 +315,35 @@ int main (int argc, char* argv[]) {
     // main render loop
     
     BeginDrawing();
+      if (rendering) {
+        BeginTextureMode(renderTarget);
+      }
       clearBackground(ctr.bgColor);
       
-      int lastMeasureNum = 0;
       int measureSpacing = MeasureTextEx(font, to_string(ctr.file.measureMap.size() - 1).c_str(), font.baseSize, 0.5).x;
 
-      for (unsigned int i = 0; i < ctr.file.measureMap.size(); i++) {
+      // measure lines, starting from the first one whose label can reach the screen
+      int firstMeasure = max(ctr.file.findMeasure(timeOffset - (nowLineX + measureSpacing + 4) / zoomLevel) - 1, 0);
+      profileScope measureTimer(PHASE_MEASURES);
+
+      // every labelStride-th measure is numbered, spaced so even the shortest measures keep labels apart,
+      // the stride only depends on zoom so labels stay on the same measures while scrolling
+      int labelStride = 1;
+      double shortestWidth = ctr.file.getShortestMeasure() * zoomLevel;
+      while (shortestWidth > 0 && labelStride * shortestWidth < measureSpacing + 10 &&
+             labelStride < (int)ctr.file.measureMap.size()) {
+        labelStride *= 2;
+      }
+
+      for (unsigned int i = firstMeasure; i < ctr.file.measureMap.size(); i++) {
         if (convertSSX(ctr.file.measureMap[i].getLocation()) + measureSpacing + 4 > 0) {
           if (convertSSX(ctr.file.measureMap[i].getLocation()) > ctr.getWidth()) {
-
+            break;
           }
           drawLineEx(convertSSX(ctr.file.measureMap[i].getLocation()), ctr.barHeight,
                      convertSSX(ctr.file.measureMap[i].getLocation()), ctr.getHeight(), 0.5, ctr.bgMeasure);
           
-          if (!i || convertSSX(ctr.file.measureMap[lastMeasureNum].getLocation()) + measureSpacing + 10 <
-                    convertSSX(ctr.file.measureMap[i].getLocation())) {
+          if (i % labelStride == 0) {
             if (sheetMusicDisplay) {
               drawTextEx(font, to_string(i + 1).c_str(), convertSSX(ctr.file.measureMap[i].getLocation()) + 4,
                          ctr.menuHeight + ctr.barHeight + 4, ctr.bgLight);
@@ -234,14 +352,14 @@ int main (int argc, char* argv[]) {
               drawTextEx(font, to_string(i + 1).c_str(), convertSSX(ctr.file.measureMap[i].getLocation()) + 4,
                          ctr.menuHeight + 4, ctr.bgLight);
             }
-            lastMeasureNum = i;
           }
         }
       }
+      measureTimer.end();
 
 
       if (nowLine) {
-        if (pointInBox(GetMousePosition(), {int(nowLineX - 3), ctr.barHeight, 6, ctr.getHeight() - ctr.barHeight}) &&
+        if (!rendering && pointInBox(GetMousePosition(), {int(nowLineX - 3), ctr.barHeight, 6, ctr.getHeight() - ctr.barHeight}) &&
             !menuctr.mouseOnMenu()) {
             drawLineEx(nowLineX, ctr.barHeight, nowLineX, ctr.getHeight(), 1, ctr.bgNow);
         }
@@ -250,50 +368,201 @@ int main (int argc, char* argv[]) {
         }
       }
 
-      // note handling
-      for (int i = 0; i < ctr.getNoteCount(); i++) {
-        
+      // shared note geometry, used by both picking and drawing
+      const float noteHeight = (ctr.getHeight() - ctr.menuHeight) / 88;
+      const auto isNoteOn = [&] (int i) {
+        return ctr.store->on[i] ||
+               (timeOffset >= ctr.store->start[i] && timeOffset < ctr.store->start[i] + ctr.store->duration[i]);
+      };
+      const auto noteWidth = [&] (int i) {
+        return ctr.store->duration[i] * zoomLevel < 1 ? 1 : ctr.store->duration[i] * zoomLevel;
+      };
+      const auto ballRadius = [&] (int i, float cX, float cW) {
+        float radius = 1 + 3 * log(cW);
+        if (cX < nowLineX - cW) {
+          radius *= 0.3;
+        }
+        if (isNoteOn(i)) {
+          radius *= (0.3f + 0.7f * (1.0f - float(timeOffset - ctr.store->start[i]) / ctr.store->duration[i]));
+        }
+        return radius;
+      };
+
+      // visible time range
+      double cullStart = timeOffset - (nowLineX + cullMargin) / zoomLevel;
+      double cullEnd = timeOffset + (ctr.getWidth() - nowLineX + cullMargin) / zoomLevel;
+
+      // hover picking, only the notes near the cursor are hit tested and only when the view or mouse moved
+      pickState pick = {GetMouseX(), GetMouseY(), timeOffset, zoomLevel, displayMode, ctr.getWidth(), ctr.getHeight(),
+                        ctr.barHeight, ctr.store, ctr.getNoteCount()};
+      if (!(pick == lastPick)) {
+        lastPick = pick;
+        hoverNote = -1;
+        hoverOn = false;
+        hoverLine.clear();
+
+        float mouseX = GetMouseX();
+        float mouseY = GetMouseY();
+        double mouseTime = timeOffset + (mouseX - nowLineX) / zoomLevel;
+        float laneStep = (ctr.getHeight() - (ctr.menuHeight + ctr.barHeight)) / float(NOTE_RANGE + 4);
+
+        const auto testSegment = [&] (vector<int>* linePositions, unsigned int j) {
+          if (pointInBox(GetMousePosition(), pointToRect({(int)convertSSX(linePositions->at(j + 1)),
+                         (int)convertSSY(linePositions->at(j + 2))}, {(int)convertSSX(linePositions->at(j + 3)),
+                         (int)convertSSY(linePositions->at(j + 4))}))) {
+            hoverNote = linePositions->at(j);
+            hoverOn = convertSSX(linePositions->at(j + 1)) <= nowLineX && convertSSX(linePositions->at(j + 3)) > nowLineX;
+            hoverLine.assign(linePositions->begin() + j, linePositions->begin() + j + 5);
+          }
+        };
+
+        if (rendering || menuctr.mouseOnMenu()) {
+          // nothing under a menu can be picked, and nothing is hovered in a render
+        }
+        else if (displayMode == DISPLAY_LINE) {
+          ctr.findVisibleLines(mouseTime - 4 / zoomLevel, mouseTime + 4 / zoomLevel, pickCandidates);
+          for (unsigned int c = 0; c < pickCandidates.size(); c++) {
+            testSegment(ctr.getLineVerts(), pickCandidates[c] * 5);
+          }
+        }
+        else if (displayMode == DISPLAY_BAR || displayMode == DISPLAY_BALL) {
+          // balls can reach past their lane, bars only cover their own
+          float reach = displayMode == DISPLAY_BALL ? pickBallReach : noteHeight;
+          int lowPitch = MIN_NOTE_IDX - 3 + (ctr.getHeight() - (mouseY + reach)) / laneStep - 1;
+          int highPitch = MIN_NOTE_IDX - 3 + (ctr.getHeight() - (mouseY - reach)) / laneStep + 1;
+          double slack = (displayMode == DISPLAY_BALL ? pickBallReach : 2) / zoomLevel;
+          ctr.getNotesNear(lowPitch, highPitch, mouseTime - slack - 1, mouseTime + slack + 1, pickCandidates);
+
+          // candidates are in draw order, the last hit is the topmost note
+          for (unsigned int c = 0; c < pickCandidates.size(); c++) {
+            int i = pickCandidates[c];
+            float cX = convertSSX(ctr.store->start[i]);
+            float cY = convertSSY(ctr.store->pitch[i]);
+            float cW = noteWidth(i);
+            bool hit = false;
+
+            if (displayMode == DISPLAY_BAR) {
+              hit = cX + cW > 0 && cX < ctr.getWidth() &&
+                    pointInBox(GetMousePosition(), (rect){int(cX), int(cY), int(cW), int(noteHeight)});
+            }
+            else {
+              float radius = ballRadius(i, cX, cW);
+              float ballY = cY + 2;
+              if (cX + cW + radius > 0 && cX - radius < ctr.getWidth()) {
+                float realX = cX > nowLineX ? int(cX) : (cX + cW < nowLineX ? int(cX + cW) : nowLineX);
+                float dx = mouseX - realX;
+                float dy = mouseY - int(ballY);
+                float startX = mouseX - int(cX);
+                hit = dx * dx + dy * dy < radius * radius ||
+                      (realX == nowLineX && (startX * startX + dy * dy < radius * radius ||
+                       pointInBox(GetMousePosition(), (rect) {int(cX), int(ballY) - 2, max(int(nowLineX - cX), 0), 4})));
+              }
+            }
+
+            if (hit) {
+              hoverNote = i;
+              hoverOn = isNoteOn(i);
+            }
+          }
+        }
+      }
+      clickTmp = hoverNote;
+      clickOnTmp = hoverOn;
+
+      // line segment drawing, shared between prebuilt and live segments
+      const auto drawLineSegment = [&] (vector<int>* linePositions, unsigned int j) {
         int colorID = 0;
         bool noteOn = false;
-        
-        const auto updateClickIndex = [&] {
-          noteOn ? clickOnTmp = true : clickOnTmp = false;
+        switch (colorMode) {
+          case COLOR_PART:
+            colorID = ctr.store->track[linePositions->at(j)];
+            break;
+          case COLOR_VELOCITY:
+            colorID = ctr.store->velocity[linePositions->at(j)];
+            break;
+          case COLOR_TONIC:
+            colorID = (ctr.store->pitch[linePositions->at(j)] - MIN_NOTE_IDX + tonicOffset) % 12 ;
+            break;
+        }
+        if (convertSSX(linePositions->at(j + 1)) <= nowLineX && convertSSX(linePositions->at(j + 3)) > nowLineX) {
+          noteOn = true;
+        }
+        if (hoverLine.size() == 5 && equal(hoverLine.begin(), hoverLine.end(), linePositions->begin() + j)) {
           noteOn = !noteOn;
-          clickTmp = i;
-        };
+        }
+        if (noteOn) {
+          drawLineEx(convertSSX(linePositions->at(j + 1)), convertSSY(linePositions->at(j + 2)),
+                     convertSSX(linePositions->at(j + 3)), convertSSY(linePositions->at(j + 4)), 
+                     2, colorSetOn->at(colorID));
+        }
+        else {
+          drawLineEx(convertSSX(linePositions->at(j + 1)), convertSSY(linePositions->at(j + 2)),
+                     convertSSX(linePositions->at(j + 3)), convertSSY(linePositions->at(j + 4)), 
+                     2, colorSetOff->at(colorID));
+        }
+      };
+
+      profileScope noteTimer(displayMode == DISPLAY_LINE ? PHASE_NOTE_LINE :
+                             (displayMode == DISPLAY_BAR ? PHASE_NOTE_BAR : PHASE_NOTE_BALL));
+      if (displayMode == DISPLAY_LINE) {
+        ctr.findVisibleLines(cullStart, cullEnd, visibleLines);
+        for (unsigned int v = 0; v < visibleLines.size(); v++) {
+          drawLineSegment(ctr.getLineVerts(), visibleLines[v] * 5);
+        }
+        profiler.count(COUNT_VISITED, visibleLines.size());
+        profiler.count(COUNT_CULLED, (long long)ctr.getLineVerts()->size() / 5 - (long long)visibleLines.size());
+        profiler.count(COUNT_DRAWN, visibleLines.size());
+        visibleNotes.clear();
+      }
+      else {
+        ctr.getVisibleNotes(cullStart, cullEnd, visibleNotes);
+        profiler.count(COUNT_VISITED, visibleNotes.size());
+        profiler.count(COUNT_CULLED, ctr.getNoteCount() - (long long)visibleNotes.size());
+      }
+
+      // file mode bars are drawn from the GPU buffer, the loop below only redraws hovered notes
+      bool batchBars = displayMode == DISPLAY_BAR && !ctr.getLiveState() && !ctr.getStreamState() && ctr.bars.isReady();
+      if (batchBars) {
+        ctr.bars.setColors(ctr.file.store, colorSetOn, colorSetOff, colorMode, tonicOffset);
+        ctr.bars.draw({timeOffset, zoomLevel, nowLineX, float(ctr.getHeight()),
+                       (ctr.getHeight() - (ctr.menuHeight + ctr.barHeight)) / float(NOTE_RANGE + 4),
+                       noteHeight, float(ctr.getWidth()), float(ctr.getHeight())},
+                      cullStart, cullEnd);
+        profiler.count(COUNT_DRAWN, visibleNotes.size());
+      }
 
+      // note handling
+      for (unsigned int v = 0; v < visibleNotes.size(); v++) {
+        int i = visibleNotes[v];
         
-        float cX = convertSSX(ctr.notes->at(i).x);
-        float cY = convertSSY(ctr.notes->at(i).y);
-        float cW = ctr.notes->at(i).duration * zoomLevel < 1 ? 1 : ctr.notes->at(i).duration * zoomLevel;
-        float cH = (ctr.getHeight() - ctr.menuHeight) / 88;
+        int colorID = 0;
+        // the hovered note is drawn inverted
+        bool noteOn = isNoteOn(i) != (i == hoverNote);
         
+        float cX = convertSSX(ctr.store->start[i]);
+        float cY = convertSSY(ctr.store->pitch[i]);
+        float cW = noteWidth(i);
+        float cH = noteHeight;
         
         switch (colorMode) {
           case COLOR_PART:
-            colorID = ctr.notes->at(i).track;
+            colorID = ctr.store->track[i];
             break;
           case COLOR_VELOCITY:
-            colorID = ctr.notes->at(i).velocity;
+            colorID = ctr.store->velocity[i];
             break;
           case COLOR_TONIC:
-            colorID = (ctr.notes->at(i).y - MIN_NOTE_IDX + tonicOffset) % 12 ;
+            colorID = (ctr.store->pitch[i] - MIN_NOTE_IDX + tonicOffset) % 12 ;
             break;
         }
         
         switch (displayMode) {
           case DISPLAY_BAR:
             if (cX + cW > 0 && cX < ctr.getWidth()) {
-                
-
-              if (ctr.notes->at(i).isOn ||
-                 (timeOffset >= ctr.notes->at(i).x && timeOffset < ctr.notes->at(i).x + ctr.notes->at(i).duration)) {
-                noteOn = true;
-              }
-              if (pointInBox(GetMousePosition(), (rect){int(cX), int(cY), int(cW), int(cH)}) && !menuctr.mouseOnMenu()) {
-                updateClickIndex();
+              if (batchBars && hoverNote != i) {
+                break;
               }
-
+              profiler.count(COUNT_DRAWN);
               if (noteOn) {
                 drawRectangle(cX, cY, cW, cH, colorSetOn->at(colorID));
               }
@@ -304,39 +573,10 @@ int main (int argc, char* argv[]) {
             break;
           case DISPLAY_BALL:
             {
-              float radius = 1 + 3 * log(cW);
+              float radius = ballRadius(i, cX, cW);
               float ballY = cY + 2;
               if (cX + cW + radius > 0 && cX - radius < ctr.getWidth()) {
-
-                  if (cX < nowLineX - cW) {
-                    radius *= 0.3;
-                  }
-                if (ctr.notes->at(i).isOn ||
-                   (timeOffset >= ctr.notes->at(i).x && timeOffset < ctr.notes->at(i).x + ctr.notes->at(i).duration)) {
-                  noteOn = true;
-                  radius *= (0.3f + 0.7f * (1.0f - float(timeOffset - ctr.notes->at(i).x) / ctr.notes->at(i).duration));
-                }
-                if (!menuctr.mouseOnMenu()) {
-                  int realX = 0;
-                  if (cX > nowLineX) {
-                    realX = cX;
-                  }
-                  else if (cX + cW < nowLineX) {
-                    realX = cX + cW;
-                  }
-                  else {
-                    realX = nowLineX;
-                  }
-                  if (getDistance(GetMouseX(), GetMouseY(), realX, ballY) < radius) {
-                    updateClickIndex();
-                  }
-                  else if (realX == nowLineX && (getDistance(GetMouseX(), GetMouseY(), cX, ballY) < radius ||
-                           pointInBox(GetMousePosition(), (rect) {int(cX), int(ballY) - 2, max(int(nowLineX - cX), 0), 4}))) {
-                    updateClickIndex();
-                  }
-                }
-                
-                
+                profiler.count(COUNT_DRAWN);
                 if (noteOn) {
                   if (cX >= nowLineX) {
                     drawRing({cX, ballY}, radius - 2, radius, colorSetOn->at(colorID));
@@ -372,115 +612,104 @@ int main (int argc, char* argv[]) {
             }
             break;
           case DISPLAY_LINE:
-            {
-              vector<int>* linePositions;
-              if (i == 0 && !ctr.getLiveState()) {
-                linePositions = ctr.file.getLineVerts();
-              }
-              else if (ctr.getLiveState()) {
-                vector<int> linePosRaw = getLinePositions(&ctr.notes->at(i), ctr.notes->at(i).getNextChordRoot());
-                linePositions = &linePosRaw;
-              }
-              else { 
-                break;
-              }
-              if (!ctr.getLiveState() || (convertSSX(ctr.notes->at(i).getNextChordRoot()->x) > 0 && cX < ctr.getWidth())) {
-                if (ctr.notes->at(i).isChordRoot()) {
-                  //cerr << i << endl;
-                  for (unsigned int j = 0; j < linePositions->size(); j += 5) {
-                    switch (colorMode) {
-                      case COLOR_PART:
-                        colorID = ctr.notes->at(linePositions->at(j)).track;
-                        break;
-                      case COLOR_VELOCITY:
-                        colorID = ctr.notes->at(linePositions->at(j)).velocity;
-                        break;
-                      case COLOR_TONIC:
-                        colorID = (ctr.notes->at(linePositions->at(j)).y - MIN_NOTE_IDX + tonicOffset) % 12 ;
-                        break;
-                    }
-                    if (convertSSX(linePositions->at(j + 1)) <= nowLineX && convertSSX(linePositions->at(j + 3)) > nowLineX) {
-                      noteOn = true;
-                    }
-                    else {
-                      noteOn = false;
-                    }
-                    if (pointInBox(GetMousePosition(), pointToRect({(int)convertSSX(linePositions->at(j + 1)),
-                                   (int)convertSSY(linePositions->at(j + 2))}, {(int)convertSSX(linePositions->at(j + 3)),
-                                   (int)convertSSY(linePositions->at(j + 4))}))) {
-                      updateClickIndex();
-                    }
-                    if (noteOn) {
-                      drawLineEx(convertSSX(linePositions->at(j + 1)), convertSSY(linePositions->at(j + 2)),
-                                 convertSSX(linePositions->at(j + 3)), convertSSY(linePositions->at(j + 4)), 
-                                 2, colorSetOn->at(colorID));
-                    }
-                    else {
-                      drawLineEx(convertSSX(linePositions->at(j + 1)), convertSSY(linePositions->at(j + 2)),
-                                 convertSSX(linePositions->at(j + 3)), convertSSY(linePositions->at(j + 4)), 
-                                 2, colorSetOff->at(colorID));
-                    }
-                  }
-                }
-              }
-            }
+            // segments are drawn above, live ones are kept up to date by midiInput
             break;
 
           case DISPLAY_BALLLINE:
             break;
         }
       }
+      noteTimer.end();
 
-      // menu bar rendering
-      drawRectangle(0, 0, ctr.getWidth(), ctr.menuHeight, ctr.bgMenu);  
+      // menu bar rendering, menuctr keeps it in a layer along with the menus
+      if (rendering) {
+        drawRectangle(0, 0, ctr.getWidth(), ctr.menuHeight, ctr.bgMenu);  
+      }
 
-      // sheet music layout
-      if (sheetMusicDisplay) {
-        // bg
-        drawRectangle(0, ctr.menuHeight, ctr.getWidth(), ctr.barHeight, ctr.bgSheet);  
+      // sheet music layout, streamed files carry no measures
+      if (sheetMusicDisplay && ctr.file.measureMap.size()) {
+        profileScope scope(PHASE_SHEET);
+        const auto drawStaves = [&] {
+          // bg
+          drawRectangle(0, ctr.menuHeight, ctr.getWidth(), ctr.barHeight, ctr.bgSheet);  
+
+          // stave lines
+          for (int i = 0; i < 2; i++) {
+            for (int j = 0; j < 5; j++) {
+              drawLineEx(30, ctr.menuHeight + ctr.barMargin + i * ctr.barSpacing + j * ctr.barWidth,
+                         ctr.getWidth() - 30, ctr.menuHeight + ctr.barMargin + i * ctr.barSpacing + j * ctr.barWidth, 1, ctr.bgDark);
+            }
+          }
+          
+          // end lines
+          drawLineEx(30, ctr.menuHeight + ctr.barMargin, 30,
+                     ctr.menuHeight + ctr.barMargin + 4 * ctr.barWidth + ctr.barSpacing, 2, ctr.bgDark);
+          drawLineEx(ctr.getWidth() - 30, ctr.menuHeight + ctr.barMargin, ctr.getWidth() - 30,
+                     ctr.menuHeight + ctr.barMargin + 4 * ctr.barWidth + ctr.barSpacing, 2, ctr.bgDark);
+
+          // static sprites
+          DrawTextureEx(ctr.brace, {18.0f, float(ctr.menuHeight + ctr.barMargin)}, 0, 1.0f, {0, 0, 0, 255});
+          DrawTextureEx(ctr.treble, {40.0f, ctr.menuHeight + 35.0f}, 0, 1.0f, {0, 0, 0, 255});
+          DrawTextureEx(ctr.bass, {40.0f, float(ctr.menuHeight + ctr.barSpacing + ctr.barMargin - 1)}, 0, 1.0f, {0, 0, 0, 255});
+        };
 
-        // stave lines
-        for (int i = 0; i < 2; i++) {
-          for (int j = 0; j < 5; j++) {
-            drawLineEx(30, ctr.menuHeight + ctr.barMargin + i * ctr.barSpacing + j * ctr.barWidth,
-                       ctr.getWidth() - 30, ctr.menuHeight + ctr.barMargin + i * ctr.barSpacing + j * ctr.barWidth, 1, ctr.bgDark);
+        // a page is the staves plus the measures from its first one up to its end,
+        // step 0 draws the staves and every later step one measure
+        const auto pageSteps = [&] (int pageFirst) {
+          return ctr.file.findPageEnd(pageFirst) - pageFirst + 2;
+        };
+        const auto drawPage = [&] (int pageFirst, int begin, int end) {
+          if (begin == 0) {
+            drawStaves();
           }
-        }
+          for (int i = pageFirst + max(begin, 1) - 1; i < pageFirst + end - 1; i++) {
+            ctr.file.measureMap[i - 1].draw(ctr.file.store, ctr.file.notes.data());
+
+            if (i < (int)ctr.file.measureMap.size()) {
+              int lineX = ctr.file.measureMap[i].getDisplayLocation();
+              drawLineEx(convertSheetX(lineX), ctr.menuHeight + ctr.barMargin,
+                         convertSheetX(lineX), ctr.menuHeight + ctr.barHeight -
+                         ctr.barMargin - 3, 0.5, ctr.bgDark);
+            }
+          }
+        };
+        const auto pageKey = [&] (int pageFirst) {
+          layerKey key;
+          key.add(pageFirst).add(ctr.getFilename()).add(int(ctr.file.measureMap.size())).add(ctr.getNoteCount());
+          key.add(ctr.getWidth()).add(ctr.barHeight).add(ctr.menuHeight).add(ctr.bgSheet).add(ctr.bgDark);
+          return key.get();
+        };
+
+        int nowMeasure = ctr.file.findMeasure(timeOffset);
         
-        // end lines
-        drawLineEx(30, ctr.menuHeight + ctr.barMargin, 30,
-                   ctr.menuHeight + ctr.barMargin + 4 * ctr.barWidth + ctr.barSpacing, 2, ctr.bgDark);
-        drawLineEx(ctr.getWidth() - 30, ctr.menuHeight + ctr.barMargin, ctr.getWidth() - 30,
-                   ctr.menuHeight + ctr.barMargin + 4 * ctr.barWidth + ctr.barSpacing, 2, ctr.bgDark);
-
-        // static sprites
-        DrawTextureEx(ctr.brace, {18.0f, float(ctr.menuHeight + ctr.barMargin)}, 0, 1.0f, {0, 0, 0, 255});
-        DrawTextureEx(ctr.treble, {40.0f, ctr.menuHeight + 35.0f}, 0, 1.0f, {0, 0, 0, 255});
-        DrawTextureEx(ctr.bass, {40.0f, float(ctr.menuHeight + ctr.barSpacing + ctr.barMargin - 1)}, 0, 1.0f, {0, 0, 0, 255});
+        // find end of sheet page
+        int lastMeasure = ctr.file.findPageEnd(nowMeasure);
+        bool useLastTime = lastMeasure >= (int)ctr.file.measureMap.size();
+
+        // pages only change at a page turn, an offline render is already offscreen so it draws directly
+        int pageFirst = ctr.file.findParentMeasure(nowMeasure);
+        if (rendering) {
+          drawPage(pageFirst, 0, pageSteps(pageFirst));
+        }
+        else {
+          // a page that is not ready at its turn, e.g. after a seek, is finished in one go
+          bool pageReady = sheetPages.isCurrent(pageFirst, pageKey(pageFirst), ctr.getWidth(), ctr.barHeight);
+          sheetPages.build(pageFirst, 0, ctr.menuHeight, ctr.getWidth(), ctr.barHeight, pageKey(pageFirst),
+                           pageSteps(pageFirst), 0, [&] (int begin, int end) { drawPage(pageFirst, begin, end); }).draw();
+
+          // the next page is drawn ahead of its turn a few measures per frame, so no frame draws a whole page
+          int nextFirst = lastMeasure + 1;
+          if (pageReady && !useLastTime) {
+            sheetPages.build(nextFirst, 0, ctr.menuHeight, ctr.getWidth(), ctr.barHeight, pageKey(nextFirst),
+                             pageSteps(nextFirst), SHEET_PREFETCH_STEPS,
+                             [&] (int begin, int end) { drawPage(nextFirst, begin, end); });
+          }
+        }
         
         // tempo
         drawTextEx(font, ("= " + to_string(ctr.getTempo(timeOffset))),
                    SHEET_LMARGIN + 20, ctr.barMargin - 17, ctr.bgDark);
         DrawTextureEx(ctr.quarter, {SHEET_LMARGIN + 10, ctr.barMargin - 20.0f}, 0, 0.5f, {0, 0, 0, 255});
-       
-        int nowMeasure = ctr.file.findMeasure(timeOffset);
-        int lastMeasure = nowMeasure;
-        bool useLastTime = false;
-        
-        // find end of sheet page
-        while (ctr.file.findParentMeasure(nowMeasure) == ctr.file.findParentMeasure(lastMeasure)) {
-          if (lastMeasure >= (int)ctr.file.measureMap.size()) {
-            lastMeasure = ctr.file.measureMap.size();
-            useLastTime = true;
-            break;
-          }
-          else if (ctr.file.findParentMeasure(nowMeasure) == ctr.file.findParentMeasure(lastMeasure + 1)) {
-            lastMeasure++;
-          }
-          else {
-            break;
-          }
-        }
 
         int pageEndLocation = (useLastTime ? ctr.getLastTime() : ctr.file.measureMap[lastMeasure].getLocation());
         
@@ -492,20 +721,6 @@ int main (int argc, char* argv[]) {
 
         //cerr << nowMeasure << " " << lastMeasure << " " << ctr.file.findParentMeasure(nowMeasure) << " " << ctr.file.measureMap[nowMeasure].getDisplayLocation() << endl;
 
-        for (int i = ctr.file.findParentMeasure(nowMeasure); i <= lastMeasure; i++) {
-            //cerr << endl;
-          ctr.file.measureMap[i - 1].draw();
-            //cerr << endl;
-
-
-          int lineX = ctr.file.measureMap[i].getDisplayLocation() - 
-                0;//ctr.file.measureMap[ctr.file.measureMap[i].getParent()].getDisplayLocation(); 
-
-          drawLineEx(convertSheetX(lineX), ctr.menuHeight + ctr.barMargin,
-                     convertSheetX(lineX), ctr.menuHeight + ctr.barHeight -
-                     ctr.barMargin - 3, 0.5, ctr.bgDark);
-        }
-        
         //cerr << ctr.file.measureMap[ctr.file.measureMap[max(0, nowMeasure - 1)].getParent()].getLocation() << " " 
         //     << pageEndLocation << " " << timeOffset << endl;
 
@@ -537,6 +752,37 @@ int main (int argc, char* argv[]) {
         }
       }
 
+      if (showProfiler) {
+        profiler.draw(font, ctr.getWidth() - 3, ctr.barHeight + 3, ctr.bgLight, ctr.bgMenuShade);
+      }
+
+      // stage report of the file on screen, streamed and live notes are not loaded in stages
+      if (showLoadStats && !rendering) {
+        if (ctr.getLiveState() || ctr.getStreamState() || ctr.file.getLoadStats().empty()) {
+          drawTextEx(font, "no load statistics", 6, ctr.barHeight + 46, ctr.bgLight);
+        }
+        else {
+          ctr.file.getLoadStats().draw(font, 6, ctr.barHeight + 46, ctr.bgLight, ctr.bgMenuShade);
+        }
+      }
+
+      // background load progress
+      if (ctr.isLoading() && !rendering) {
+        int progressWidth = ctr.getWidth() / 3;
+        int progressX = (ctr.getWidth() - progressWidth) / 2;
+        int progressY = ctr.getHeight() / 2;
+        drawRectangle(progressX, progressY, progressWidth, 6, ctr.bgMenuShade);
+        drawRectangle(progressX, progressY, progressWidth * ctr.getLoadProgress(), 6, ctr.bgMenu);
+        drawTextEx(font, ctr.getLoadStage(), progressX, progressY - 18, ctr.bgLight);
+      }
+
+      //fileMenu.draw();
+      if (!rendering) {
+        profileScope scope(PHASE_MENUS);
+        menuctr.renderAll();
+      }
+
+      // the counter sits on the menu bar, so it goes on top of it
       if (showFPS) {
         if (GetTime() - (int)GetTime() < GetFrameTime()) {
           FPSText = to_string(GetFPS());
@@ -545,22 +791,26 @@ int main (int argc, char* argv[]) {
                    ctr.getWidth() - MeasureTextEx(font, FPSText.c_str(), font.baseSize, 0.5).x - 3, 3, ctr.bgDark);
       }
 
-      //fileMenu.draw();
-      menuctr.renderAll();
-
+      if (rendering) {
+        EndTextureMode();
+      }
     EndDrawing();
+    profiler.endFrame();
 
-    // key actions
-    if (run) {
-      if (timeOffset + GetFrameTime() * 500< ctr.getLastTime()) {
-        timeOffset += GetFrameTime() * 500;
-      }
-      else {
-        timeOffset = ctr.getLastTime();
-        run = false;
+    // hand the frame to the writer, input and playback do not apply to a render
+    if (rendering) {
+      if (!renderWriter.write(GetTextureData(renderTarget.texture))) {
+        logII(LL_WARN, "render stopped at frame " + to_string(renderFrame));
+        break;
       }
+      renderFrame++;
+      continue;
     }
 
+    // key actions
+    bool wasRunning = playback.isRunning();
+    double frameOffset = timeOffset;
+
     if (colorMove) {
       if (colorSquare) {
         colorSelect.setSquare();
@@ -570,11 +820,14 @@ int main (int argc, char* argv[]) {
       }
       switch (selectType) {
         case SELECT_NOTE:
+          if (clickNote < 0 || clickNote >= ctr.getNoteCount()) {
+            break;
+          }
           if (clickOn) {
-            ctr.setTrackOn[ctr.notes->at(clickNote).track] = colorSelect.getColor();
+            ctr.setTrackOn[ctr.store->track[clickNote]] = colorSelect.getColor();
           }
           else {
-            ctr.setTrackOff[ctr.notes->at(clickNote).track] = colorSelect.getColor();
+            ctr.setTrackOff[ctr.store->track[clickNote]] = colorSelect.getColor();
           }
           break;
         case SELECT_BG:
@@ -604,7 +857,12 @@ int main (int argc, char* argv[]) {
       }
     }
     if (IsKeyPressed(KEY_SPACE)) {
-      run = !run; 
+      if (playback.isRunning()) {
+        playback.pause();
+      }
+      else {
+        playback.play();
+      }
     }
     if (IsKeyDown(KEY_LEFT)) {
       if (IsKeyDown(KEY_LEFT_CONTROL) || IsKeyDown(KEY_RIGHT_CONTROL)) {
@@ -648,6 +906,23 @@ int main (int argc, char* argv[]) {
     if (IsKeyDown(KEY_END)) {
       timeOffset = ctr.getLastTime();
     }
+
+    // keys move the view, the transport carries on from there, a live view scrolls back through the session
+    bool moved = timeOffset != frameOffset;
+    if (moved) {
+      playback.seek(timeOffset);
+      if (ctr.getLiveState()) {
+        ctr.liveInput.scrollTo(timeOffset);
+      }
+    }
+
+    // output runs on a copy of the transport, so it restarts whenever the transport changes
+    if (playback.isRunning() && (!wasRunning || moved)) {
+      ctr.playOutput(playback);
+    }
+    else if (!playback.isRunning() && ctr.output.isPlaying()) {
+      ctr.output.stop();
+    }
     if (IsMouseButtonPressed(MOUSE_LEFT_BUTTON)) {
       switch(fileMenu.getActiveElement()) {
         case -1:
@@ -674,10 +949,40 @@ int main (int argc, char* argv[]) {
             case 2:
               break;
             case 3:
-              break;
+              if (isMKI(ctr.getFilename())) {
+                ctr.save(ctr.getFilename());
+                menuctr.hideAll();
+                break;
+              }
+              // fall through, files that are not mki need a new name
             case 4:
+              filenameC = osdialog_file(OSDIALOG_SAVE, ".", nullptr, savetypes);
+
+              if (filenameC != nullptr) {
+                ctr.save(static_cast<string>(filenameC));
+                free(filenameC);
+              }
+
+              menuctr.hideAll();
               break;
             case 5:
+              filenameC = osdialog_file(OSDIALOG_SAVE, ".", nullptr, imagetypes);
+
+              if (filenameC != nullptr) {
+                // the whole song at the current zoom, as tall as the roll on screen
+                ctr.exportImage(static_cast<string>(filenameC),
+                                {0, double(ctr.getLastTime()), zoomLevel, ctr.getHeight() - ctr.menuHeight, displayMode,
+                                 colorMode, tonicOffset, colorSetOff, ctr.bgColor, ctr.bgMeasure});
+                free(filenameC);
+              }
+
+              menuctr.hideAll();
+              break;
+            case 6:
+              showLoadStats = !showLoadStats;
+              menuctr.hideAll();
+              break;
+            case 7:
                 ctr.setCloseFlag(); 
               break;
           }
@@ -835,6 +1140,24 @@ int main (int argc, char* argv[]) {
               showFPS = !showFPS;
               FPSText = to_string(GetFPS());
               break;
+            case 6:
+              if (viewMenu.getContent(6) == "Show Profiler") {
+                viewMenu.setContent("Hide Profiler", 6);
+              }
+              else if (viewMenu.getContent(6) == "Hide Profiler") {
+                viewMenu.setContent("Show Profiler", 6);
+              }
+              showProfiler = !showProfiler;
+              break;
+            case 7:
+              if (profiler.isRecording()) {
+                profiler.stopCSV();
+                viewMenu.setContent("Record Profile", 7);
+              }
+              else if (profiler.startCSV(PROFILE_CSV)) {
+                viewMenu.setContent("Stop Recording", 7);
+              }
+              break;
           }
           break;
       }
@@ -848,9 +1171,26 @@ int main (int argc, char* argv[]) {
           if (!inputMenu.render) {
             break;
           }
+          if (!ctr.getLiveState()) {
+            logII(LL_WARN, "cannot open port in normal mode");
+            break;
+          }
           ctr.liveInput.openPort(inputMenu.getActiveElement());
           break;
       }
+      switch(outputMenu.getActiveElement()) {
+        case -1:
+          if (!outputMenu.parentOpen() || outputMenu.parent->getActiveElement() == -1) {
+            outputMenu.render = false;
+          }
+          break;
+        default:
+          if (!outputMenu.render) {
+            break;
+          }
+          ctr.output.openPort(outputMenu.getActiveElement());
+          break;
+      }
       switch(midiMenu.getActiveElement()) {
         case -1:
           if (!midiMenu.childOpen()) {
@@ -876,6 +1216,14 @@ int main (int argc, char* argv[]) {
               }
               break;
             case 2:
+              if (midiMenu.childOpen() && outputMenu.render == false) {
+                midiMenu.hideChildMenu();
+                outputMenu.render = true;
+              }
+              else {
+                outputMenu.update(ctr.output.getPorts());
+                outputMenu.render = !outputMenu.render;
+              }
               break;
             case 3:
               if (midiMenu.getContent(3) == "Enable Live Play") {
@@ -1060,7 +1408,10 @@ int main (int argc, char* argv[]) {
               }
               break;
             case 2:
-              tonicOffset = (ctr.notes->at(clickNote).y - MIN_NOTE_IDX + tonicOffset) % 12;
+              if (clickNote < 0 || clickNote >= ctr.getNoteCount()) {
+                break;
+              }
+              tonicOffset = (ctr.store->pitch[clickNote] - MIN_NOTE_IDX + tonicOffset) % 12;
               break;
           }
           break;
@@ -1083,9 +1434,9 @@ int main (int argc, char* argv[]) {
         int rightX = 0, rightY = 0, colorX = 0, colorY = 0;
 
         if (clickNote != -1) {
-          rightX = round(nowLineX + (ctr.notes->at(clickNote).x - timeOffset) * zoomLevel);
+          rightX = round(nowLineX + (ctr.store->start[clickNote] - timeOffset) * zoomLevel);
           rightY = (ctr.getHeight() - round((ctr.getHeight() - ctr.menuHeight) * 
-                    static_cast<double>(ctr.notes->at(clickNote).y - MIN_NOTE_IDX + 3)/(NOTE_RANGE + 3)));
+                    static_cast<double>(ctr.store->pitch[clickNote] - MIN_NOTE_IDX + 3)/(NOTE_RANGE + 3)));
         }
         
         // find coordinate to draw right click menu
@@ -1101,14 +1452,14 @@ int main (int argc, char* argv[]) {
           selectType = SELECT_NOTE;
           rightMenuContents[1] = "Change Part Color";
           rightMenu.update(rightMenuContents);
-          rightMenu.setContent(getNoteInfo(ctr.notes->at(clickNote).track, ctr.notes->at(clickNote).y - MIN_NOTE_IDX), 0);
+          rightMenu.setContent(getNoteInfo(ctr.store->track[clickNote], ctr.store->pitch[clickNote] - MIN_NOTE_IDX), 0);
           
           // set note color for color wheel
           if (clickOn) {
-            colorSelect.setColor(ctr.setTrackOn[ctr.notes->at(clickNote).track]);
+            colorSelect.setColor(ctr.setTrackOn[ctr.store->track[clickNote]]);
           }
           else{
-            colorSelect.setColor(ctr.setTrackOff[ctr.notes->at(clickNote).track]);
+            colorSelect.setColor(ctr.setTrackOff[ctr.store->track[clickNote]]);
           }
         }
         else {
@@ -1141,9 +1492,19 @@ int main (int argc, char* argv[]) {
     ctr.updateKeyState();
   }
 
+  if (rendering) {
+    renderWriter.close();
+    UnloadRenderTexture(renderTarget);
+    logII(LL_INFO, "rendered " + to_string(renderWriter.getFrameCount()) + " frames");
+  }
+
+  ctr.shutdown();
   osdialog_filters_free(filetypes); 
   osdialog_filters_free(savetypes); 
   osdialog_filters_free(imagetypes); 
+  ctr.bars.unload();
+  sheetPages.unload();
+  menuctr.unloadLayers();
   UnloadFont(font);
   CloseWindow();
   return 0;
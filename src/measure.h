@@ -2,11 +2,15 @@
 
 #include <vector>
 #include "note.h"
+#include "store.h"
 #include "timekey.h"
 #include "unimo.h"
 
 using std::vector;
 
+// measure count above which measure layout is split across the thread pool
+#define LAYOUT_PARALLEL_MIN 256
+
 class measureController {
   public:
     measureController() {
@@ -39,7 +43,9 @@ class measureController {
     }
   
     void findLength();
-    void draw();
+    // defined in measuredraw.cc, which is not part of the core library
+    // first is the file's first note, pitches are looked up in store by note index
+    void draw(noteStore& store, note* first);
     
     double getLocation() { return location; }
     int getLength() { return length; }
@@ -50,6 +56,7 @@ class measureController {
     
 
     friend class midi;
+    friend class mkiFile;
   private:
     int getUMOWidth();
     int getUMOEvents();
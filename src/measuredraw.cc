@@ -0,0 +1,54 @@
+#include <raylib.h>
+#include "measure.h"
+#include "data.h"
+#include "define.h"
+#include "wrap.h"
+
+// drawing stays with the app, the layout in measure.cc is part of the core library
+
+void measureController::draw(noteStore& store, note* first) {
+  double cSpaceIdx= 0.35;
+  for (unsigned int i = 0; i < allEvents.size(); i++) {
+    double relativePosition = (allEvents[i].getTick() - tick) / static_cast<double>(tickLength);
+    double absolutePosition = SHEET_LMARGIN + displayX + (expandRatio * cSpaceIdx * SHEET_NOTEWIDTH);
+
+    switch(allEvents[i].getType()) {
+      case UMO_NOTE:
+        {
+          vector<note*>* chord = static_cast<vector<note*>*>(allEvents[i].getRawEvent());
+          for (unsigned int j = 0; j < chord->size(); j++) { 
+            float noteHeadX = round(absolutePosition);
+            float noteHeadY = getSheetY(store.pitch[chord->at(j) - first]);
+            DrawTextureEx(ctr.quarter, {noteHeadX, noteHeadY}, 0, 1.0f, {0, 0, 0, 255});
+            DrawTextureEx(ctr.flag, {noteHeadX + 10, noteHeadY - 25}, 0, 1.0f, {0, 0, 0, 255});
+        
+            drawLineEx(noteHeadX + 10, noteHeadY + 4, noteHeadX + 10, noteHeadY - 25, 1.5, ctr.bgDark);
+            //cerr << chord->at(j)->getKeySig()->getKey() << endl;
+          }
+        }
+        break;
+      case UMO_TIME:
+        drawTextEx(ctr.fontMusic, to_string(static_cast<timeSig*>(allEvents[i].getRawEvent())->top),
+                   absolutePosition, ctr.barMargin + 19, ctr.bgDark);
+        drawTextEx(ctr.fontMusic, to_string(static_cast<timeSig*>(allEvents[i].getRawEvent())->bottom),
+                   absolutePosition, ctr.barMargin + 39, ctr.bgDark);
+        drawTextEx(ctr.fontMusic, to_string(static_cast<timeSig*>(allEvents[i].getRawEvent())->top),
+                   absolutePosition, ctr.barSpacing + ctr.barMargin + 19, ctr.bgDark);
+        drawTextEx(ctr.fontMusic, to_string(static_cast<timeSig*>(allEvents[i].getRawEvent())->bottom),
+                   absolutePosition, ctr.barSpacing + ctr.barMargin + 39, ctr.bgDark);
+        break;
+      case UMO_KEY:
+        drawTextEx(ctr.fontMusic, to_string(static_cast<keySig*>(allEvents[i].getRawEvent())->getKey()),
+                   absolutePosition, ctr.barSpacing + ctr.barMargin + 39, ctr.bgDark);
+    }
+   
+    cSpaceIdx += allEvents[i].getSize();
+    //cerr << cSpaceIdx << " " << relativePosition << endl; 
+  }
+}
+
+int measureController::getSheetY(int noteY) {
+  int distC = (noteY - MIN_NOTE_IDX + 9) / 12;
+  //cerr << distC<< endl;
+  return ctr.barMargin + ctr.barSpacing / 2 + 5 * distC;
+}
@@ -352,118 +352,135 @@ colorRGB menu::getColor() {
 
 void menu::draw() {
   findActiveElement(ctr.getMousePosition());
-   if (type == TYPE_MAIN) {
-    if (render) {
-      drawRectangle(x, y, mainSize, ITEM_HEIGHT, ctr.bgMenuShade);
-      drawRectangle(x, getItemY(1), width, height - ITEM_HEIGHT, ctr.bgMenu);
-      if (getActiveElement() != -1) {
-        if (getActiveElement() == 0) {
-          drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), mainSize, ITEM_HEIGHT, ctr.bgMenuShade);
-        }
-        else {
-          drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), ITEM_WIDTH, ITEM_HEIGHT, ctr.bgMenuShade);
-        }
-      }
-      for (int i = 1; i < itemCount; i++) {
-        drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 0.5, ctr.bgMenuLine);
-      }
-      for (int i = 0; i < itemCount; i++) {
-        if (i == 0) {
-          drawTextEx(font, getContent(i).c_str(), getItemX(i) + 4, getItemY(i) + 4, ctr.bgDark);
-        }
-        else {
-          drawTextEx(font, getContent(i).c_str(), getItemX(i) + 4, getItemY(i) + 5, ctr.bgDark);
-        }
-      }
+  if (type == TYPE_MAIN) {
+    drawTitle();
+  }
+  if (render) {
+    drawBody();
+  }
+}
+
+void menu::drawTitle() {
+  if (render || getActiveElement() == 0) {
+    drawRectangle(x, y, mainSize, ITEM_HEIGHT, ctr.bgMenuShade);
+  }
+  else {
+    drawRectangle(x, y, mainSize, ITEM_HEIGHT, ctr.bgMenu);
+  }
+  drawTextEx(font, getContent(0).c_str(), getItemX(0) + 4, getItemY(0) + 4, ctr.bgDark);
+}
+
+void menu::drawBody() {
+  if (type == TYPE_MAIN) {
+    drawRectangle(x, getItemY(1), width, height - ITEM_HEIGHT, ctr.bgMenu);
+    if (getActiveElement() > 0) {
+      drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), ITEM_WIDTH, ITEM_HEIGHT, ctr.bgMenuShade);
+    }
+    for (int i = 1; i < itemCount; i++) {
+      drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 0.5, ctr.bgMenuLine);
+    }
+    for (int i = 1; i < itemCount; i++) {
+      drawTextEx(font, getContent(i).c_str(), getItemX(i) + 4, getItemY(i) + 5, ctr.bgDark);
     }
-    else { 
-      if (getActiveElement() == 0) {
-        drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), mainSize, ITEM_HEIGHT, ctr.bgMenuShade);
-      }
-      else {
-        drawRectangle(x, y, mainSize, ITEM_HEIGHT, ctr.bgMenu);
-      }
-      drawTextEx(font, getContent(0).c_str(), getItemX(0) + 4, getItemY(0) + 4, ctr.bgDark);
-    }  
   }
   else if (type == TYPE_COLOR) {
-    if (render) {
-      
-      const float circleRatio = 0.425;
-      const float circleWidth = 0.075;
-      const float squareDim = (circleRatio - circleWidth - 0.05) * COLOR_WIDTH * sqrt(2);
-      const float circleX = x + COLOR_WIDTH/2.0f;
-      const float circleY = y + COLOR_HEIGHT/2.0f;
-
-      drawRectangle(x, y, COLOR_WIDTH, COLOR_HEIGHT, ctr.bgMenu);
-      
-      for (int i = 0; i < 360; i++) {
-        //DrawCircleSectorLines({x + COLOR_WIDTH/2.0f, y + COLOR_HEIGHT/2.0f},
-        //                      circleRatio * COLOR_WIDTH, i, i + 1, 3, ColorFromHSV({float(i), 1, 1}));
-        double rad = i * M_PI / 180;
-        DrawLineEx({circleX, circleY},
-                   {float(circleX + circleRatio * COLOR_WIDTH * cos(rad)),
-                   float(circleY + circleRatio * COLOR_WIDTH * sin(rad))},
-                   2.0f, ColorFromHSV({float(360 - i), 1, 1}));
-      }
+    const float circleRatio = 0.425;
+    const float circleWidth = 0.075;
+    const float squareDim = (circleRatio - circleWidth - 0.05) * COLOR_WIDTH * sqrt(2);
+    const float circleX = x + COLOR_WIDTH/2.0f;
+    const float circleY = y + COLOR_HEIGHT/2.0f;
+
+    drawRectangle(x, y, COLOR_WIDTH, COLOR_HEIGHT, ctr.bgMenu);
     
-      drawCircle(circleX, circleY, (circleRatio - circleWidth) * COLOR_WIDTH, ctr.bgMenu);
-      
-      drawCircle(circleX, circleY, (circleRatio - circleWidth) * COLOR_WIDTH, ctr.bgMenu);
-
-      for (int sqX = -squareDim/2.0; sqX < squareDim/2.0; sqX++) {
-        for (int sqY = -squareDim/2.0; sqY < squareDim/2.0; sqY++) {
-          DrawPixel(circleX + sqX, circleY + sqY, ColorFromHSV({float(angle),
-                    0.5f + float(sqX / squareDim), 0.5f + float(-sqY / squareDim)}));
-        }
+    for (int i = 0; i < 360; i++) {
+      //DrawCircleSectorLines({x + COLOR_WIDTH/2.0f, y + COLOR_HEIGHT/2.0f},
+      //                      circleRatio * COLOR_WIDTH, i, i + 1, 3, ColorFromHSV({float(i), 1, 1}));
+      double rad = i * M_PI / 180;
+      DrawLineEx({circleX, circleY},
+                 {float(circleX + circleRatio * COLOR_WIDTH * cos(rad)),
+                 float(circleY + circleRatio * COLOR_WIDTH * sin(rad))},
+                 2.0f, ColorFromHSV({float(360 - i), 1, 1}));
+    }
+  
+    drawCircle(circleX, circleY, (circleRatio - circleWidth) * COLOR_WIDTH, ctr.bgMenu);
+    
+    drawCircle(circleX, circleY, (circleRatio - circleWidth) * COLOR_WIDTH, ctr.bgMenu);
+
+    for (int sqX = -squareDim/2.0; sqX < squareDim/2.0; sqX++) {
+      for (int sqY = -squareDim/2.0; sqY < squareDim/2.0; sqY++) {
+        DrawPixel(circleX + sqX, circleY + sqY, ColorFromHSV({float(angle),
+                  0.5f + float(sqX / squareDim), 0.5f + float(-sqY / squareDim)}));
       }
-      DrawRing({float(circleX - squareDim/2.0 + pX), float(circleY - squareDim/2.0 + pY)}, 
-               0.0f, 5.0f, 0.0f, 360.0f, 2, ColorFromHSV({float(fmod(angle, 360.0)), 0.3f, 1.0f})); 
-      
-      DrawRing({float(circleX + (circleRatio - circleWidth/2.0) * COLOR_WIDTH * cos(angle * M_PI/180.0)),
-                float(circleY - (circleRatio - circleWidth/2.0) * COLOR_HEIGHT * sin(angle * M_PI/180.0))},
-                0.0f, 5.0f, 0.0f, 360.0f, 2, ColorFromHSV({float(fmod(angle, 360.0)), 0.3f, 1.0f})); 
-      
-      drawRectangle(x + COLOR_WIDTH - 36, y + COLOR_HEIGHT - 36, 36, 36, getColor());
-
-      int yOffset = MeasureTextEx(font, colorToHex(getColor()).c_str(), font.baseSize, 0.5).y;
-      drawTextEx(font, colorToHex(getColor()).c_str(), x + 4, y + COLOR_HEIGHT - yOffset - 2, ctr.bgDark);
     }
+    DrawRing({float(circleX - squareDim/2.0 + pX), float(circleY - squareDim/2.0 + pY)}, 
+             0.0f, 5.0f, 0.0f, 360.0f, 2, ColorFromHSV({float(fmod(angle, 360.0)), 0.3f, 1.0f})); 
+    
+    DrawRing({float(circleX + (circleRatio - circleWidth/2.0) * COLOR_WIDTH * cos(angle * M_PI/180.0)),
+              float(circleY - (circleRatio - circleWidth/2.0) * COLOR_HEIGHT * sin(angle * M_PI/180.0))},
+              0.0f, 5.0f, 0.0f, 360.0f, 2, ColorFromHSV({float(fmod(angle, 360.0)), 0.3f, 1.0f})); 
+    
+    drawRectangle(x + COLOR_WIDTH - 36, y + COLOR_HEIGHT - 36, 36, 36, getColor());
+
+    int yOffset = MeasureTextEx(font, colorToHex(getColor()).c_str(), font.baseSize, 0.5).y;
+    drawTextEx(font, colorToHex(getColor()).c_str(), x + 4, y + COLOR_HEIGHT - yOffset - 2, ctr.bgDark);
   }
   else {
-    if (render) {
-      drawRectangle(x, y, width, height, ctr.bgMenu);
-      if (getActiveElement() != -1) {
-        drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), ITEM_WIDTH, ITEM_HEIGHT, ctr.bgMenuShade);
-      }
+    drawRectangle(x, y, width, height, ctr.bgMenu);
+    if (getActiveElement() != -1) {
+      drawRectangle(getItemX(getActiveElement()), getItemY(getActiveElement()), ITEM_WIDTH, ITEM_HEIGHT, ctr.bgMenuShade);
+    }
 
-      bool rightFlag = false;
-      if (type == TYPE_RIGHT) {
-        rightFlag = true;
-      }
+    bool rightFlag = false;
+    if (type == TYPE_RIGHT) {
+      rightFlag = true;
+    }
 
-      bool lineFlag = false;
-      if (parent != nullptr && parent->getItemY(1) < getItemY(0)) {
-        lineFlag = true;
-      }
+    bool lineFlag = false;
+    if (parent != nullptr && parent->getItemY(1) < getItemY(0)) {
+      lineFlag = true;
+    }
 
-      if (!rightFlag) {
-        drawLineEx(x, y, x, y + height, 0.5, ctr.bgMenuLine);
-      }
+    if (!rightFlag) {
+      drawLineEx(x, y, x, y + height, 0.5, ctr.bgMenuLine);
+    }
 
-      for (int i = 0; i < itemCount; i++) {
-        if (i == 0 && lineFlag) {
-          drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 1, {0, 0, 0});
-        }
-        else if (!rightFlag) {
-          drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 0.5, ctr.bgMenuLine);
-        }
-        rightFlag = false;
+    for (int i = 0; i < itemCount; i++) {
+      if (i == 0 && lineFlag) {
+        drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 1, {0, 0, 0});
       }
-
-      for (int i = 0; i < itemCount; i++) {
-        drawTextEx(font, getContent(i).c_str(), getItemX(i) + 4, getItemY(i) + 5, ctr.bgDark);
+      else if (!rightFlag) {
+        drawLineEx(x, getItemY(i) + 1, x + ITEM_WIDTH, getItemY(i) + 1, 0.5, ctr.bgMenuLine);
       }
+      rightFlag = false;
     }
+
+    for (int i = 0; i < itemCount; i++) {
+      drawTextEx(font, getContent(i).c_str(), getItemX(i) + 4, getItemY(i) + 5, ctr.bgDark);
+    }
+  }
+}
+
+rect menu::getBodyBox() {
+  // one pixel of slack keeps the edge lines
+  if (type == TYPE_MAIN) {
+    return {x - 1, getItemY(1) - 1, width + 2, height - ITEM_HEIGHT + 2};
+  }
+  else if (type == TYPE_COLOR) {
+    return {x - 1, y - 1, COLOR_WIDTH + 2, COLOR_HEIGHT + 2};
+  }
+  return {x - 1, y - 1, width + 2, height + 2};
+}
+
+void menu::addBodyKey(layerKey& key) {
+  key.add(type).add(width).add(height).add(itemCount).add(activeElement);
+  for (int i = 0; i < itemCount; i++) {
+    key.add(getContent(i));
+  }
+  if (type == TYPE_COLOR) {
+    key.add(angle).add(pX).add(pY);
+  }
+  if (parent != nullptr && parent->itemCount > 1) {
+    key.add(parent->getItemY(1) < getItemY(0));
   }
+  key.add(ctr.bgMenu).add(ctr.bgMenuShade).add(ctr.bgMenuLine).add(ctr.bgDark);
 }
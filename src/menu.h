@@ -6,6 +6,7 @@
 #include "misc.h"
 #include "data.h"
 #include "define.h"
+#include "layer.h"
 
 using std::string;
 using std::vector;
@@ -72,6 +73,12 @@ class menu {
     bool clickCircle(int circleType);
 
     void draw();
+    // main menu title, drawn into the menu bar
+    void drawTitle();
+    // everything but the title, only while the menu is open
+    void drawBody();
+    rect getBodyBox();
+    void addBodyKey(layerKey& key);
 
     bool render;
 
@@ -94,6 +101,8 @@ class menu {
     double angle = 0;
     vector<menuItem> items;
     vector<menu*> childMenu;
+
+    renderLayer layer;
 };
 
 enum menuTypes {
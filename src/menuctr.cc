@@ -1,5 +1,7 @@
 #include "menuctr.h"
 #include "misc.h"
+#include "wrap.h"
+#include "define.h"
 
 void menuController::registerMenu(menu* newMenu) {
   if (newMenu->type == TYPE_MAIN) {
@@ -10,8 +12,43 @@ void menuController::registerMenu(menu* newMenu) {
 }
 
 void menuController::renderAll() {
+  // the bar holds the background and every main menu title
+  layerKey barKey;
+  barKey.add(ctr.getWidth()).add(ctr.menuHeight).add(ctr.bgMenu).add(ctr.bgMenuShade).add(ctr.bgDark);
   for (unsigned int i = 0; i < menuSet.size(); i++) {
-    menuSet[i]->draw();
+    menuSet[i]->findActiveElement(ctr.getMousePosition());
+    if (menuSet[i]->type == TYPE_MAIN) {
+      barKey.add(menuSet[i]->render).add(menuSet[i]->getActiveElement() == 0).add(menuSet[i]->getContent(0));
+    }
+  }
+
+  barLayer.update(0, 0, ctr.getWidth(), ctr.menuHeight, barKey.get(), [&] {
+    drawRectangle(0, 0, ctr.getWidth(), ctr.menuHeight, ctr.bgMenu);
+    for (unsigned int i = 0; i < menuSet.size(); i++) {
+      if (menuSet[i]->type == TYPE_MAIN) {
+        menuSet[i]->drawTitle();
+      }
+    }
+  });
+  barLayer.draw();
+
+  for (unsigned int i = 0; i < menuSet.size(); i++) {
+    menu* m = menuSet[i];
+    if (!m->render) {
+      continue;
+    }
+    layerKey key;
+    m->addBodyKey(key);
+    rect box = m->getBodyBox();
+    m->layer.update(box.x, box.y, box.width, box.height, key.get(), [m] { m->drawBody(); });
+    m->layer.draw();
+  }
+}
+
+void menuController::unloadLayers() {
+  barLayer.unload();
+  for (unsigned int i = 0; i < menuSet.size(); i++) {
+    menuSet[i]->layer.unload();
   }
 }
 
@@ -17,8 +17,10 @@ class menuController {
     
 
     void registerMenu(menu* newMenu);
+    // composites the cached menu bar and open menus, redrawing only the ones that changed
     void renderAll();
     void hideAll();
+    void unloadLayers();
 
     bool mouseOnMenu();
 
@@ -29,5 +31,6 @@ class menuController {
     int mainMenuOffset;
     bool mouseMenu;
     vector<menu*> menuSet;
+    renderLayer barLayer;
     
 };
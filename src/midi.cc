@@ -1,33 +1,42 @@
 #include <algorithm>
+#include <atomic>
+#include <functional>
+#include <queue>
 #include "midi.h"
 #include "misc.h"
 #include "data.h"
 #include "sheetctr.h"
-#include "define.h"
+#include "pool.h"
 
 using std::max;
+using std::upper_bound;
+using std::lower_bound;
+using std::stable_sort;
+using std::atomic;
+using std::priority_queue;
+using std::greater;
+
+namespace {
+  // a note as it comes out of its track, split into note and store once tracks are merged
+  struct trackNote {
+    note sheet;
+    double start;
+    double duration;
+    int pitch;
+    int velocity;
+    int channel;
+  };
+}
 
 int midi::getTempo(int offset) {
-  int tempo = 120;
-  if (tempoMap.size() != 0 && offset == 0) {
-    return tempoMap[0].second;
-  }
-  if (offset > tempoMap[tempoMap.size() - 1].first) {
-    return tempoMap[tempoMap.size() - 1].second;
-  }
-  for (unsigned int i = 0; i < tempoMap.size(); i++) {
-    if (offset > tempoMap[i].first && offset < tempoMap[i + 1].first) {
-      return tempoMap[i].second;
-    }
-  }
-  return tempo;
+  return timing.getTempo(offset);
 }
 
 void midi::buildLineMap() {
   vector<int> tmpVerts;
-  for (unsigned int i = 0; i < notes.size(); i++) {
-    if (notes[i].isChordRoot()) {
-      tmpVerts = getLinePositions(&notes[i], notes[i].getNextChordRoot());
+  for (int i = 0; i < store.size(); i++) {
+    if (store.isChordRoot(i)) {
+      tmpVerts = getLinePositions(store, i, store.getNextChordRoot(i));
       lineVerts.insert(lineVerts.end(), tmpVerts.begin(), tmpVerts.end());
     }
   }
@@ -36,6 +45,21 @@ void midi::buildLineMap() {
   //logII(LL_CRIT, lineVerts.size());
 }
 
+void midi::buildIndex() {
+  buildMeasureIndex();
+  buildPageIndex();
+
+  noteIdx.build(store);
+  pickIdx.build(store);
+
+  // index segments by their x span, one id per 5 vertex values
+  lineIdx.clear();
+  for (unsigned int i = 0; i < lineVerts.size(); i += 5) {
+    lineIdx.add(i / 5, lineVerts[i + 1], lineVerts[i + 3]);
+  }
+  lineIdx.finalize();
+}
+
 void midi::buildTickMap() {
   if (!tpq) {
     logII(LL_CRIT, "invalid MIDI");
@@ -47,50 +71,32 @@ void midi::buildTickMap() {
   }
 }
 
-void midi::findMeasure(note& idxNote) {
-  // requires a built measure map
-  if (measureMap[measureMap.size() - 1].location <= idxNote.x) {
-   idxNote.measure = measureMap.size() - 1;
-   measureMap[measureMap.size() - 1].notes.push_back(&idxNote);
-   return;
-  }
-  for (unsigned int i = 0; i <= measureMap.size(); i++) {
-    if (measureMap[i].location <= idxNote.x && measureMap[i + 1].location > idxNote.x) {
-      idxNote.measure = i;
-      measureMap[i].notes.push_back(&idxNote);
-      return;
+void midi::assignMeasures() {
+  // requires a built measure index
+  for (int i = 0; i < store.size(); i++) {
+    if (!store.isChordRoot(i)) {
+      continue;
+    }
+    int measure = upper_bound(measureStarts.begin(), measureStarts.end(), store.start[i]) - measureStarts.begin() - 1;
+    notes[i].measure = measure;
+    if (measure < 0) {
+      logII(LL_CRIT, i);
+      continue;
     }
+    measureMap[measure].notes.push_back(&notes[i]);
   }
-  logII(LL_CRIT, idxNote.number);
-  idxNote.measure = -1;
-  return;
 }
 
 void midi::findKeySig(note& idxNote) {
-  if (idxNote.x >= sheetData.keySignatureMap[sheetData.keySignatureMap.size() - 1].first) {
-    idxNote.setKeySig(&(sheetData.keySignatureMap[sheetData.keySignatureMap.size() - 1].second));
-    return;
-  }
-  for (unsigned int i = 0; i < sheetData.keySignatureMap.size(); i++) {
-    if (sheetData.keySignatureMap[i].first <= idxNote.x && sheetData.keySignatureMap[i + 1].first > idxNote.x) {
-      idxNote.setKeySig(&(sheetData.keySignatureMap[i].second));
-      return;
-    }
+  int key = timing.getKeySigAtTick(idxNote.tick);
+  if (key >= 0) {
+    idxNote.setKeySig(&(sheetData.keySignatureMap[key].second));
   }
 }
 
 int midi::findMeasure(int offset) {
-  if (!offset ) { return 0; }
-  if (measureMap[measureMap.size() - 1].location < offset) {
-    return measureMap.size();
-  } 
-  // requires a built measure map
-  for (unsigned int i = 0; i < measureMap.size(); i++) {
-    if (measureMap[i].location < offset && measureMap[i + 1].location >= offset) {
-      return i + 1;
-    }
-  }
-  return -1;
+  // number of measures starting strictly before offset
+  return lower_bound(measureStarts.begin(), measureStarts.end(), offset) - measureStarts.begin();
 }
 
 int midi::findParentMeasure(int measure) {
@@ -103,31 +109,98 @@ int midi::findParentMeasure(int measure) {
   return measureMap[measure - 1].parentMeasure + 1;
 }
 
-void midi::load(string file) {
-  MidiFile midifile;
-  if (!midifile.read(file.c_str())) {
-    logII(LL_WARN, "unable to open MIDI");
-    return;
+int midi::findPageEnd(int measure) {
+  if (measure < 0 || measure >= static_cast<int>(pageEnds.size())) {
+    return measure;
+  }
+  return pageEnds[measure];
+}
+
+void midi::buildMeasureIndex() {
+  measureStarts.resize(measureMap.size());
+  shortestMeasure = 0;
+  for (unsigned int i = 0; i < measureMap.size(); i++) {
+    measureStarts[i] = measureMap[i].location;
+    if (i && (i == 1 || measureStarts[i] - measureStarts[i - 1] < shortestMeasure)) {
+      shortestMeasure = measureStarts[i] - measureStarts[i - 1];
+    }
+  }
+}
+
+void midi::buildPageIndex() {
+  // sweep backwards so each measure learns where its page ends
+  int count = measureMap.size();
+  pageEnds.assign(count + 1, count);
+  for (int m = count - 1; m >= 0; m--) {
+    pageEnds[m] = findParentMeasure(m) == findParentMeasure(m + 1) ? pageEnds[m + 1] : m;
   }
+}
 
+void midi::clear() {
   notes.clear();
+  store.clear();
   tempoMap.clear();
+  timing.clear();
   tracks.clear();
   trackHeightMap.clear();
   lineVerts.clear();
   measureMap.clear();
   measureTickMap.clear();
   tickMap.clear();
+  measureStarts.clear();
+  shortestMeasure = 0;
+  pageEnds.clear();
   sheetData.reset();
+  noteIdx.clear();
+  lineIdx.clear();
+  pickIdx.clear();
 
   noteCount = 0;
   trackCount = 0;
+  lastTime = 0;
+  lastTick = 0;
   tpq = 0;
+}
+
+// reports the stage and returns false if the load was cancelled
+static bool enterStage(loadProgress* progress, int stage) {
+  if (progress == nullptr) {
+    return true;
+  }
+  progress->stage = stage;
+  progress->fraction = 0;
+  return !progress->cancel;
+}
 
+bool midi::load(string file, int sheetSize, loadProgress* progress) {
+  enterStage(progress, LOAD_PARSE);
+  stats.clear();
+  stats.begin("read");
+  MidiFile midifile;
+  if (!midifile.read(file.c_str())) {
+    logII(LL_WARN, "unable to open MIDI");
+    return false;
+  }
+
+  clear();
+
+  // the parser passes cannot be interrupted, a cancelled load stops between them
+  if (progress != nullptr && progress->cancel) {
+    return false;
+  }
+  stats.begin("link note pairs");
   midifile.linkNotePairs();
  
+  if (progress != nullptr && progress->cancel) {
+    return false;
+  }
+  stats.begin("time analysis");
   midifile.doTimeAnalysis();
   
+  if (progress != nullptr && progress->cancel) {
+    return false;
+  }
+
   trackCount = midifile.getTrackCount();
   tracks.resize(trackCount);
 
@@ -137,85 +210,144 @@ void midi::load(string file) {
 
   buildTickMap();
 
-  vector<pair<double, int>> trackInfo;
+  if (!enterStage(progress, LOAD_NOTES)) {
+    return false;
+  }
 
-  for (int i = 0; i < trackCount; i++) {
-    bool once = true;
-    for (int j = 0; j < midifile.getEventCount(i); j++) {
-      if (midifile[i][j].isNoteOn()) {
-        if (once) {
-          once = false;
-          trackInfo.push_back(make_pair(midifile[i][j].seconds * 500, i));
+  // each track is extracted on its own into a separate buffer, along with its meta and channel events
+  stats.begin("extract notes");
+  vector<vector<trackNote>> trackNotes(trackCount);
+  vector<vector<MidiEvent*>> trackMeta(trackCount);
+  vector<vector<MidiEvent*>> trackControls(trackCount);
+  atomic<int> tracksDone(0);
+
+  getThreadPool().parallelFor(trackCount, 1, [&](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      if (progress != nullptr && progress->cancel) {
+        return;
+      }
+      for (int j = 0; j < midifile.getEventCount(i); j++) {
+        MidiEvent& event = midifile[i][j];
+        if (event.isNoteOn()) {
+          trackNote n;
+          n.sheet.tick = event.tick;
+          n.sheet.tickDuration = event.getTickDuration();
+          n.sheet.findSize(tickMap);
+          n.start = event.seconds * 500;
+          n.duration = event.getDurationInSeconds() * 500;
+          n.pitch = event.getKeyNumber();
+          n.velocity = event[2];
+          n.channel = event.getChannel();
+          trackNotes[i].push_back(n);
+        }
+        else if (event.isPatchChange() || event.isController()) {
+          trackControls[i].push_back(&event);
+        }
+        else if (event.isTempo() || event.isTimeSignature() || event.isKeySignature()) {
+          trackMeta[i].push_back(&event);
         }
-        noteCount++;
+      }
+      if (progress != nullptr) {
+        progress->fraction = static_cast<float>(++tracksDone) / trackCount;
       }
     }
+  });
+
+  if (progress != nullptr && progress->cancel) {
+    return false;
+  }
+
+  for (int i = 0; i < trackCount; i++) {
+    noteCount += trackNotes[i].size();
   }
 
   if (noteCount == 0) {
     logII(LL_WARN, "zero length file");
-    return;
+    return false;
   }
 
-  sort(trackInfo.begin(), trackInfo.end());
-
+  stats.begin("merge tracks");
   notes.resize(noteCount);
+  store.reserve(noteCount);
   int idx = 0;
 
-  for (unsigned int track = 0; track < trackInfo.size(); track++) {
-    int i = trackInfo[track].second;
-    for (int j = 0; j < midifile.getEventCount(i); j++) {
-      if (midifile[i][j].isNoteOn()) {
-        notes[idx].number = idx;
-        notes[idx].tick = midifile[i][j].tick;
-        notes[idx].tickDuration = midifile[i][j].getTickDuration();
-        notes[idx].track = i;
-        notes[idx].duration = midifile[i][j].getDurationInSeconds() * 500;
-        notes[idx].x  = midifile[i][j].seconds * 500;
-        notes[idx].y = midifile[i][j].getKeyNumber();
-        notes[idx].velocity = midifile[i][j][2];
-
-        notes[idx].findSize(tickMap);
+  // k-way merge of the track buffers on start time, ties go to the lower track
+  using mergeHead = pair<double, int>;
+  priority_queue<mergeHead, vector<mergeHead>, greater<mergeHead>> heads;
+  vector<unsigned int> cursors(trackCount, 0);
+  for (int i = 0; i < trackCount; i++) {
+    if (trackNotes[i].size()) {
+      heads.push(make_pair(trackNotes[i][0].start, i));
+    }
+  }
 
-        //cerr << midifile.getTimeInSeconds(notes[idx].tick) << " " << midifile[i][j].seconds << endl;
+  while (!heads.empty()) {
+    int i = heads.top().second;
+    heads.pop();
 
-        tracks.at(notes[idx].track).insert(idx, &notes.at(idx));
+    const trackNote& n = trackNotes[i][cursors[i]];
+    notes[idx] = n.sheet;
+    tracks.at(i).insert(i, n.start, n.pitch);
+    store.add(n.start, n.duration, n.pitch, i, n.velocity, n.channel);
+    idx++;
 
-        idx++;
-      }
+    if (++cursors[i] < trackNotes[i].size()) {
+      heads.push(make_pair(trackNotes[i][cursors[i]].start, i));
     }
   }
 
-  midifile.joinTracks();
-  midifile.sortTracks();
+  // channel events keep their file order within a tick, output replays them between the notes
+  vector<MidiEvent*> controlEvents;
+  for (int i = 0; i < trackCount; i++) {
+    controlEvents.insert(controlEvents.end(), trackControls[i].begin(), trackControls[i].end());
+  }
+  stable_sort(controlEvents.begin(), controlEvents.end(), [](const MidiEvent* left, const MidiEvent* right) {
+    return left->tick < right->tick;
+  });
+  store.controls.reserve(controlEvents.size());
+  for (const MidiEvent* event : controlEvents) {
+    channelEvent control;
+    control.time = event->seconds * 500;
+    control.data[0] = (*event)[0];
+    control.data[1] = (*event)[1];
+    control.data[2] = event->isController() ? (*event)[2] : 0;
+    store.controls.push_back(control);
+  }
+
+  // meta events are few, order them by tick as sortTracks would
+  stats.begin("meta events");
+  vector<MidiEvent*> metaEvents;
+  for (int i = 0; i < trackCount; i++) {
+    metaEvents.insert(metaEvents.end(), trackMeta[i].begin(), trackMeta[i].end());
+  }
+  stable_sort(metaEvents.begin(), metaEvents.end(), [](const MidiEvent* left, const MidiEvent* right) {
+    return left->tick < right->tick;
+  });
   
-  for (int i = 0; i < midifile.getEventCount(0); i++) {
+  for (unsigned int i = 0; i < metaEvents.size(); i++) {
+    MidiEvent& event = *metaEvents[i];
 
-    if (midifile[0][i].isTempo()) {
-      tempoMap.push_back(make_pair(midifile[0][i].seconds * 500, midifile[0][i].getTempoBPM()));
+    if (event.isTempo()) {
+      tempoMap.push_back(make_pair(event.tick, event.getTempoBPM()));
     }
-    if (midifile[0][i].isTimeSignature()) {
-      //log3(LL_INFO, "time sig at event", j);
-      //cerr << (int)midifile[0][i][3] << " " << pow(2, (int) midifile[0][i][4])<< endl;
-      sheetData.addTimeSignature(midifile[0][i].seconds * 500, midifile[0][i].tick,
-                                 {(int)midifile[0][i][3], (int)pow(2, (int)midifile[0][i][4]), -1});
+    if (event.isTimeSignature()) {
+      sheetData.addTimeSignature(event.seconds * 500, event.tick, {(int)event[3], (int)pow(2, (int)event[4]), -1});
+    }
+    if (event.isKeySignature()) {
+      sheetData.addKeySignature(event.seconds * 500, event.tick, 
+                                sheetData.eventToKeySignature((int)event[3], (bool)event[4]));
     }
-    if (midifile[0][i].isKeySignature()) {
-      //log3(LL_INFO, "key sig at event", i);
-      //cerr << (int)midifile[0][i][1] << " " << (int)midifile[0][i][3] << " " << (int)midifile[0][i][4] <<  endl;
-      //cerr << midifile[0][i].seconds * 500 << endl;;
-      sheetData.addKeySignature(midifile[0][i].seconds * 500, midifile[0][i].tick, 
-                                sheetData.eventToKeySignature((int)midifile[0][i][3], (bool)midifile[0][i][4]));
-      }
   }
 
   // link keysigs
   sheetData.linkKeySignatures();
 
-  for (unsigned int i = 0; i < tracks.size(); i++) {
-    // assign chord to last note of each track
-    tracks[i].fixLastNote();
+  timing.build(tpq, tempoMap, sheetData);
 
+  // assign chord to last note of each track
+  store.finish();
+
+  for (unsigned int i = 0; i < tracks.size(); i++) {
     // build track height map
     trackHeightMap.push_back(make_pair(i, tracks[i].getAverageY()));
   }
@@ -224,7 +356,12 @@ void midi::load(string file) {
     return left.second < right.second;
   });
  
+  if (!enterStage(progress, LOAD_MEASURES)) {
+    return false;
+  }
+
   // build measure map
+  stats.begin("measure map");
   int cTick = 0;
   timeSig cTimeSig = sheetData.timeSignatureMap[0].second;
   idx = 0;
@@ -241,32 +378,30 @@ void midi::load(string file) {
   //  cerr << cTimeSig.top << " " << cTimeSig.bottom << endl;
     if (idx + 1 != (int)sheetData.timeSignatureMap.size()) {
       cTick += cTimeSig.qpm * tpq;
-      if (midifile.getTimeInSeconds(cTick) * 500>= sheetData.timeSignatureMap[idx + 1].first) {
+      if (timing.tickToTime(cTick) >= sheetData.timeSignatureMap[idx + 1].first) {
         cTimeSig = sheetData.timeSignatureMap[++idx].second;
       }
-      measureMap.push_back(measureController(midifile.getTimeInSeconds(cTick) * 500, cTick, cTimeSig.qpm * tpq));
+      measureMap.push_back(measureController(timing.tickToTime(cTick), cTick, cTimeSig.qpm * tpq));
     }
     else {
       while (cTick < lastTick) {
         cTick += cTimeSig.qpm * tpq;
         
-        measureMap.push_back(measureController(midifile.getTimeInSeconds(cTick) * 500, cTick, cTimeSig.qpm * tpq));
+        measureMap.push_back(measureController(timing.tickToTime(cTick), cTick, cTimeSig.qpm * tpq));
       }
       break;
     }
   }
   measureMap.pop_back(); 
+  buildMeasureIndex();
+
+  // assign measures to chord roots
+  assignMeasures();
 
-  // assign measures and key signatures to notes
+  // assign key signatures to notes
+  stats.begin("key signatures");
   for (unsigned int i = 0; i < notes.size(); i++) {
-    if (notes[i].isChordRoot()) {
-      findMeasure(notes[i]);
-      //cerr << notes[i].measure << endl;
-    }
     findKeySig(notes[i]);
-
-    // get sheet position of note
-    notes[i].findSheetY();
   }
 
   // assign measures to time signatures
@@ -284,20 +419,39 @@ void midi::load(string file) {
     ////cerr << sheetData.keySignatureMap[i].second.getSize() << " " << sheetData.keySignatureMap[i].second.measure << endl;
   }
 
+  if (!enterStage(progress, LOAD_LAYOUT)) {
+    return false;
+  }
+
   // then find length of measure from notes
+  stats.begin("measure length");
+  // measures are independent here, so large files lay them out in parallel
+  if (measureMap.size() >= LAYOUT_PARALLEL_MIN) {
+    getThreadPool().parallelFor(measureMap.size(), 64, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        measureMap[i].findLength();
+      }
+    });
+  }
+  else {
+    for (unsigned int i = 0; i < measureMap.size(); i++) {
+      measureMap[i].findLength();
+    }
+  }
+
   int adjustedLength = 0;
   for (unsigned int i = 0; i < measureMap.size(); i++) {
-    measureMap[i].findLength();
     measureMap[i].displayX += adjustedLength;
     adjustedLength += measureMap[i].getLength();
   }
 
   // then wrap measures to segments and resize measures to fit
+  stats.begin("page wrap");
   bool isSinglePage = measureMap[measureMap.size() - 1].getDisplayLocation() + measureMap[measureMap.size() - 1].getLength() <
-                      ctr.getSheetSize();
+                      sheetSize;
   if (isSinglePage) {
     // handle single page case 
-    double expandRatio = static_cast<double>(ctr.getSheetSize()) / (measureMap[measureMap.size() - 1].getDisplayLocation() +
+    double expandRatio = static_cast<double>(sheetSize) / (measureMap[measureMap.size() - 1].getDisplayLocation() +
                          measureMap[measureMap.size() - 1].getLength());
 
     for (unsigned int i = 0; i <= measureMap.size(); i++) {
@@ -311,7 +465,7 @@ void midi::load(string file) {
     int lastMeasureBreak = 0;
     for (int i = 0; i <= (int)measureMap.size(); i++) {
       if (measureMap[i].getDisplayLocation() + measureMap[i].getLength() - measureMap[lastMeasureBreak].getDisplayLocation() > 
-          ctr.getSheetSize() || i >= (int)measureMap.size()) {
+          sheetSize || i >= (int)measureMap.size()) {
         
         int measureLimit = (i == (int)measureMap.size() ? i : i - 2);
 
@@ -340,8 +494,8 @@ void midi::load(string file) {
           }
           j++;
         }
-        int extraSpace = ctr.getSheetSize() - measureMap[i + j - 1].getDisplayLocation();
-        double expandRatio = 1.0 + static_cast<double>(extraSpace) / ctr.getSheetSize();
+        int extraSpace = sheetSize - measureMap[i + j - 1].getDisplayLocation();
+        double expandRatio = 1.0 + static_cast<double>(extraSpace) / sheetSize;
         //cerr << expandRatio << endl;
         
         for (int k = i; k < i + j; k++) {
@@ -354,12 +508,31 @@ void midi::load(string file) {
   }
 
 
+  if (!enterStage(progress, LOAD_LINES)) {
+    return false;
+  }
+
   // build line vertex map
+  stats.begin("line map");
   buildLineMap();
 
+  // build visible note and line indices
+  stats.begin("indices");
+  buildIndex();
+  stats.finish();
+
+  stats.setValue("notes", noteCount);
+  stats.setValue("tracks", trackCount);
+  stats.setValue("measures", measureMap.size());
+  vector<string> lines = stats.report();
+  for (unsigned int i = 0; i < lines.size(); i++) {
+    logII(LL_INFO, "load " + lines[i]);
+  }
+
   //lastTime = notes[getNoteCount() - 1].x + notes[getNoteCount() - 1].duration;
   //logII(LL_CRIT, (midifile.getFileDurationInTicks()) / (tpq * 4) + 1);
   //logII(LL_CRIT, measureMap.size());
-    
+
+  return true;
 }
 
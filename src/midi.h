@@ -9,6 +9,12 @@
 #include "timekey.h"
 #include "sheetctr.h"
 #include "measure.h"
+#include "timeline.h"
+#include "noteidx.h"
+#include "pickidx.h"
+#include "store.h"
+#include "progress.h"
+#include "stats.h"
 #include "log.h"
 
 using namespace smf;
@@ -37,39 +43,73 @@ class midi {
       noteCount = 0;
       lastTime = 0;
       lastTick = 0;
+      shortestMeasure = 0;
 
       tpq = 0;
     }
 
-    void load(string file);
+    // sheetSize is the width pages are wrapped to, nothing is read from the window
+    // progress is optional, a cancelled load returns false and leaves a partial file
+    bool load(string file, int sheetSize, loadProgress* progress = nullptr);
     
     vector<int>* getLineVerts() { return &lineVerts; }
+    void findVisibleNotes(double start, double end, vector<int>& result) { noteIdx.query(start, end, result); }
+    void findVisibleLines(double start, double end, vector<int>& result) { lineIdx.query(start, end, result); }
+    void findNotesNear(int lowPitch, int highPitch, double start, double end, vector<int>& result) {
+      pickIdx.query(lowPitch, highPitch, start, end, result);
+    }
     int findMeasure(int offset);
     int findParentMeasure(int measure);
+    // last measure on the same sheet page, in findMeasure numbering
+    int findPageEnd(int measure);
+    // duration of the shortest measure but the last, 0 with fewer than two measures
+    double getShortestMeasure() { return shortestMeasure; }
+    // time and memory per stage of the last load
+    loadStats& getLoadStats() { return stats; }
 
     vector<note> notes;
+    noteStore store;
     sheetController sheetData;
     vector<measureController> measureMap;
     vector<measureController> measureTickMap;
 
     friend class midiInput;
     friend class controller;
+    friend class mkiFile;
   private:
-    vector<pair<double, int>> tempoMap;
+    // (tick, bpm)
+    vector<pair<int, double>> tempoMap;
     vector<trackController> tracks;
     vector<pair<int, double>> trackHeightMap;
     vector<int> lineVerts;
     vector<int> tickMap;
+    timeline timing;
+
+    // measure start locations, kept apart from measureMap for binary search
+    vector<double> measureStarts;
+    double shortestMeasure;
+    // page end per measure number, see findPageEnd
+    vector<int> pageEnds;
+
+    noteIndex noteIdx;
+    noteIndex lineIdx;
+    pickIndex pickIdx;
+
+    loadStats stats;
 
     int getTrackCount() { return trackCount; }
     int getNoteCount() { return noteCount; }
     int getLastTime() { return lastTime; }
     int getTempo(int offset);
     
+    void clear();
     void buildLineMap();
+    void buildIndex();
+    void buildMeasureIndex();
+    void buildPageIndex();
     void buildTickMap();
 
-    void findMeasure(note& idxNote);
+    void assignMeasures();
     void findKeySig(note& idxNote);
 
 
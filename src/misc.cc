@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cstdio>
 #include <iomanip>
 #include <sstream>
 #include "misc.h"
@@ -78,14 +79,6 @@ colorRGB HSVtoRGB(const colorHSV& hsv) {
   return output;
 }
 
-bool pointInBox(Vector2 mouse, rect box) {
-  if (mouse.x >= box.x && mouse.x < box.x + box.width &&
-      mouse.y >= box.y && mouse.y < box.y + box.height) {
-    return true;
-  }
-  return false;
-}
-
 void getMenuLocation(int mainW, int mainH, int cnX, int cnY, 
                      int& rcX, int& rcY, const int rcW, const int rcH) {
   // note: this function finds the menu starting point (X, Y) and stores them in
@@ -308,73 +301,75 @@ string toMinutes(double seconds) {
   return result;
 }
 
-vector<int> getLinePositions(note* now, note* next) {
+vector<int> getLinePositions(noteStore& store, int now, int next) {
   vector<int> linePos = {};
 
-  note* pNow = now;
-  note* pNext = next;
+  int pNow = now;
+  int pNext = next;
   bool pushLine = false;
 
-  if (!pNext) {
-    if (!(pNow->isLastOnTrack)) {
-      logII(LL_CRIT, "pNext is nullptr");
+  if (pNext == -1) {
+    if (!store.lastOnTrack[pNow]) {
+      logII(LL_CRIT, "pNext is -1");
     }
     return {};
   }
 
   auto pushVerts = [&] {
-      linePos.push_back(now->number);
+      linePos.push_back(now);
       
-      linePos.push_back(pNow->x);
-      linePos.push_back(pNow->y);
+      linePos.push_back(store.start[pNow]);
+      linePos.push_back(store.pitch[pNow]);
       
       if (!pushLine) {
-        linePos.push_back(pNext->x);
-        linePos.push_back(pNext->y);
+        linePos.push_back(store.start[pNext]);
+        linePos.push_back(store.pitch[pNext]);
       }
       else {
-        linePos.push_back(pNow->x + pNow->duration);
-        linePos.push_back(pNow->y);
+        linePos.push_back(store.start[pNow] + store.duration[pNow]);
+        linePos.push_back(store.pitch[pNow]);
       }
   };
 
   // only link spatially near notes
-  if (now->x + 2 * now->duration < next->x) {
+  if (store.start[now] + 2 * store.duration[now] < store.start[next]) {
     pushLine = true;
   }
 
+  int nowSize = store.getChordSize(now);
+  int nextSize = store.getChordSize(next);
 
-  if (now->getChordSize() == next->getChordSize()) {
-    for (int i = 0; i < now->getChordSize(); i++) {
+  if (nowSize == nextSize) {
+    for (int i = 0; i < nowSize; i++) {
       pushVerts();
-      pNow = pNow->chordNext;
-      pNext = pNext->chordNext;
+      pNow = store.chordNext[pNow];
+      pNext = store.chordNext[pNext];
     }
   }
-  else if (now->getChordSize() > next->getChordSize()) {
-    for (int i = 0; i < next->getChordSize(); i++) {
+  else if (nowSize > nextSize) {
+    for (int i = 0; i < nextSize; i++) {
       pushVerts();
-      pNow = pNow->chordNext;
-      if (i != next->getChordSize() - 1) {
-        pNext = pNext->chordNext;
+      pNow = store.chordNext[pNow];
+      if (i != nextSize - 1) {
+        pNext = store.chordNext[pNext];
       }
     }
-    for (int i = 0; i < now->getChordSize() - next->getChordSize(); i++) {
+    for (int i = 0; i < nowSize - nextSize; i++) {
       pushVerts();
-      pNow = pNow->chordNext;
+      pNow = store.chordNext[pNow];
     }
   }
   else {
-    for (int i = 0; i < now->getChordSize(); i++) {
+    for (int i = 0; i < nowSize; i++) {
       pushVerts();
-      pNext = pNext->chordNext;
-      if (i != now->getChordSize() - 1) {
-        pNow = pNow->chordNext;
+      pNext = store.chordNext[pNext];
+      if (i != nowSize - 1) {
+        pNow = store.chordNext[pNow];
       }
     }
-    for (int i = 0; i < next->getChordSize() - now->getChordSize(); i++) {
+    for (int i = 0; i < nextSize - nowSize; i++) {
       pushVerts();
-      pNext = pNext->chordNext;
+      pNext = store.chordNext[pNext];
     }
   }
 
@@ -401,3 +396,8 @@ rect pointToRect(point a, point b) {
   return result;
 }
 
+string formatNumber(const char* format, double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), format, value);
+  return buffer;
+}
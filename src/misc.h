@@ -2,9 +2,9 @@
 
 #include <string>
 #include <vector>
-#include <raylib.h>
 #include "color.h"
 #include "note.h"
+#include "store.h"
 #include "box.h"
 
 using std::vector;
@@ -16,7 +16,6 @@ double getDistance(int x1, int y1, int x2, int y2);
 colorHSV RGBtoHSV(const colorRGB& rgb);
 colorRGB HSVtoRGB(const colorHSV& hsv);
 
-bool pointInBox(Vector2 mouse, rect box);
 rect pointToRect(point a, point b);
 
 
@@ -25,9 +24,14 @@ void getColorSelectLocation(int mainW, int mainH, int& cpX, int& cpY, int rcX, i
 
 string colorToHex(colorRGB col);
 
+// line segments between two chord roots, 5 values per segment
+vector<int> getLinePositions(noteStore& store, int now, int next);
+
 string getNoteInfo(int noteTrack, int notePos);
 
 string getSongPercent (double pos, double total);
 string getSongTime(double pos,  double total);
 string toMinutes(double seconds);
+// printf style formatting of a single number
+string formatNumber(const char* format, double value);
 
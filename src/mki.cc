@@ -0,0 +1,404 @@
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mki.h"
+#include "colorgen.h"
+#include "log.h"
+
+using std::map;
+
+bool isMKI(const string& filename) {
+  if (filename.size() < 4) {
+    return false;
+  }
+  string ext = filename.substr(filename.size() - 4);
+  for (unsigned int i = 0; i < ext.size(); i++) {
+    ext[i] = tolower(ext[i]);
+  }
+  return ext == ".mki";
+}
+
+namespace {
+  // sections are padded so every record starts 8 byte aligned
+  uint64_t alignSection(uint64_t offset) {
+    return (offset + 7) & ~static_cast<uint64_t>(7);
+  }
+
+  template <typename T>
+  bool writeSection(FILE* out, mkiHeader& header, int section, const vector<T>& data, uint64_t& offset) {
+    offset = alignSection(offset);
+    header.sections[section].offset = offset;
+    header.sections[section].count = data.size();
+    if (fseek(out, offset, SEEK_SET) != 0) {
+      return false;
+    }
+    if (data.size() && fwrite(data.data(), sizeof(T), data.size(), out) != data.size()) {
+      return false;
+    }
+    offset += data.size() * sizeof(T);
+    return true;
+  }
+
+  template <typename T>
+  const T* readSection(const char* base, size_t fileSize, const mkiHeader* header, int section) {
+    const mkiSection& sec = header->sections[section];
+    if (sec.offset % 8 || sec.offset > fileSize || sec.count > (fileSize - sec.offset) / sizeof(T)) {
+      return nullptr;
+    }
+    return reinterpret_cast<const T*>(base + sec.offset);
+  }
+}
+
+bool mkiFile::save(const string& filename, midi& file, vector<colorRGB>& on, vector<colorRGB>& off) {
+  if (file.notes.empty()) {
+    logII(LL_WARN, "nothing to save");
+    return false;
+  }
+
+  mkiHeader header;
+  memset(&header, 0, sizeof(header));
+  header.magic = MKI_MAGIC;
+  header.version = MKI_VERSION;
+  header.trackCount = file.trackCount;
+  header.noteCount = file.noteCount;
+  header.tpq = file.tpq;
+  header.lastTick = file.lastTick;
+  header.lastTime = file.lastTime;
+
+  note* base = &file.notes[0];
+  const auto noteIndex = [&] (note* n) {
+    return static_cast<int32_t>(n - base);
+  };
+
+  map<keySig*, int32_t> keyIndex;
+  vector<mkiKeySig> keySigs;
+  for (unsigned int i = 0; i < file.sheetData.keySignatureMap.size(); i++) {
+    keySig& ks = file.sheetData.keySignatureMap[i].second;
+    keyIndex[&ks] = i;
+    keySigs.push_back({file.sheetData.keySignatureMap[i].first, ks.getKey(), ks.isMinor, ks.measure, ks.tick, 0});
+  }
+
+  vector<mkiTimeSig> timeSigs;
+  for (unsigned int i = 0; i < file.sheetData.timeSignatureMap.size(); i++) {
+    timeSig& ts = file.sheetData.timeSignatureMap[i].second;
+    timeSigs.push_back({file.sheetData.timeSignatureMap[i].first, ts.top, ts.bottom, ts.measure, ts.tick, 0});
+  }
+
+  vector<mkiNote> notes(file.notes.size());
+  for (unsigned int i = 0; i < file.notes.size(); i++) {
+    note& n = file.notes[i];
+    notes[i] = {n.size, n.tick, n.tickDuration, file.store.track[i], n.measure, file.store.pitch[i],
+                file.store.duration[i], file.store.start[i], file.store.velocity[i], file.store.lastOnTrack[i],
+                file.store.prev[i], file.store.next[i], file.store.chordNext[i],
+                keyIndex.count(n.key) ? keyIndex[n.key] : -1, file.store.channel[i], 0};
+  }
+
+  vector<mkiControl> controls;
+  for (const channelEvent& c : file.store.controls) {
+    controls.push_back({c.time, {c.data[0], c.data[1], c.data[2]}, {0, 0, 0, 0, 0}});
+  }
+
+  vector<mkiTempo> tempos;
+  for (unsigned int i = 0; i < file.tempoMap.size(); i++) {
+    tempos.push_back({file.timing.tickToTime(file.tempoMap[i].first), file.tempoMap[i].second, file.tempoMap[i].first, 0});
+  }
+
+  vector<mkiMeasure> measures;
+  vector<int32_t> measureNotes;
+  for (unsigned int i = 0; i < file.measureMap.size(); i++) {
+    measureController& m = file.measureMap[i];
+    measures.push_back({m.location, m.expandRatio, m.length, m.tick, m.tickLength, m.parentMeasure,
+                        m.displayX, m.displayLength, (int32_t)measureNotes.size(), (int32_t)m.notes.size()});
+    for (unsigned int j = 0; j < m.notes.size(); j++) {
+      measureNotes.push_back(noteIndex(m.notes[j]));
+    }
+  }
+
+  vector<mkiTrackHeight> heights;
+  for (unsigned int i = 0; i < file.trackHeightMap.size(); i++) {
+    heights.push_back({file.trackHeightMap[i].first, 0, file.trackHeightMap[i].second});
+  }
+
+  vector<mkiColor> colors;
+  for (unsigned int i = 0; i < on.size() && i < off.size(); i++) {
+    colors.push_back({{on[i].r, on[i].g, on[i].b}, {off[i].r, off[i].g, off[i].b}});
+  }
+
+  vector<int32_t> lineVerts(file.lineVerts.begin(), file.lineVerts.end());
+  vector<int32_t> tickMap(file.tickMap.begin(), file.tickMap.end());
+
+  FILE* out = fopen(filename.c_str(), "wb");
+  if (out == nullptr) {
+    logII(LL_WARN, "unable to open " + filename + " for writing");
+    return false;
+  }
+
+  uint64_t offset = sizeof(mkiHeader);
+  bool ok = writeSection(out, header, MKI_NOTES, notes, offset) &&
+            writeSection(out, header, MKI_TEMPO, tempos, offset) &&
+            writeSection(out, header, MKI_TIMESIG, timeSigs, offset) &&
+            writeSection(out, header, MKI_KEYSIG, keySigs, offset) &&
+            writeSection(out, header, MKI_MEASURES, measures, offset) &&
+            writeSection(out, header, MKI_MEASURE_NOTES, measureNotes, offset) &&
+            writeSection(out, header, MKI_LINE_VERTS, lineVerts, offset) &&
+            writeSection(out, header, MKI_TRACK_HEIGHT, heights, offset) &&
+            writeSection(out, header, MKI_TICK_MAP, tickMap, offset) &&
+            writeSection(out, header, MKI_COLORS, colors, offset) &&
+            writeSection(out, header, MKI_CONTROLS, controls, offset);
+
+  // header goes last so a partial write is never mistaken for a valid file
+  ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+  ok = (fclose(out) == 0) && ok;
+
+  if (!ok) {
+    logII(LL_WARN, "unable to write " + filename);
+    remove(filename.c_str());
+    return false;
+  }
+  log3(LL_INFO, "saved mki with notes", file.notes.size());
+  return true;
+}
+
+bool mkiFile::load(const string& filename, midi& file, vector<colorRGB>& on, vector<colorRGB>& off) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    logII(LL_WARN, "unable to open " + filename);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(mkiHeader)) {
+    logII(LL_WARN, "invalid mki file");
+    close(fd);
+    return false;
+  }
+
+  size_t fileSize = st.st_size;
+  void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    logII(LL_WARN, "unable to map " + filename);
+    return false;
+  }
+
+  const char* base = static_cast<const char*>(mapped);
+  const mkiHeader* header = reinterpret_cast<const mkiHeader*>(base);
+
+  if (header->magic != MKI_MAGIC) {
+    logII(LL_WARN, "not an mki file: " + filename);
+    munmap(mapped, fileSize);
+    return false;
+  }
+  if (header->version != MKI_VERSION) {
+    log3(LL_WARN, "unsupported mki version", header->version);
+    munmap(mapped, fileSize);
+    return false;
+  }
+
+  const mkiNote* notes = readSection<mkiNote>(base, fileSize, header, MKI_NOTES);
+  const mkiTempo* tempos = readSection<mkiTempo>(base, fileSize, header, MKI_TEMPO);
+  const mkiTimeSig* timeSigs = readSection<mkiTimeSig>(base, fileSize, header, MKI_TIMESIG);
+  const mkiKeySig* keySigs = readSection<mkiKeySig>(base, fileSize, header, MKI_KEYSIG);
+  const mkiMeasure* measures = readSection<mkiMeasure>(base, fileSize, header, MKI_MEASURES);
+  const int32_t* measureNotes = readSection<int32_t>(base, fileSize, header, MKI_MEASURE_NOTES);
+  const int32_t* lineVerts = readSection<int32_t>(base, fileSize, header, MKI_LINE_VERTS);
+  const mkiTrackHeight* heights = readSection<mkiTrackHeight>(base, fileSize, header, MKI_TRACK_HEIGHT);
+  const int32_t* tickMap = readSection<int32_t>(base, fileSize, header, MKI_TICK_MAP);
+  const mkiColor* colors = readSection<mkiColor>(base, fileSize, header, MKI_COLORS);
+  const mkiControl* controls = readSection<mkiControl>(base, fileSize, header, MKI_CONTROLS);
+
+  if (!notes || !tempos || !timeSigs || !keySigs || !measures || !measureNotes ||
+      !lineVerts || !heights || !tickMap || !colors || !controls) {
+    logII(LL_WARN, "truncated mki file: " + filename);
+    munmap(mapped, fileSize);
+    return false;
+  }
+
+  const uint64_t noteCount = header->sections[MKI_NOTES].count;
+  const uint64_t keyCount = header->sections[MKI_KEYSIG].count;
+  const uint64_t measureCount = header->sections[MKI_MEASURES].count;
+  const uint64_t measureNoteCount = header->sections[MKI_MEASURE_NOTES].count;
+  const uint64_t lineVertCount = header->sections[MKI_LINE_VERTS].count;
+  const uint64_t heightCount = header->sections[MKI_TRACK_HEIGHT].count;
+  const uint64_t controlCount = header->sections[MKI_CONTROLS].count;
+  const int64_t trackCount = header->trackCount;
+
+  // the header counts size the file's vectors, they have to agree with the sections
+  if (trackCount < 0 || trackCount > MKI_MAX_TRACKS || header->noteCount < 0 ||
+      (uint64_t)header->noteCount != noteCount || heightCount > (uint64_t)trackCount) {
+    logII(LL_WARN, "corrupt mki header in " + filename);
+    munmap(mapped, fileSize);
+    return false;
+  }
+
+  const auto validNote = [&] (int32_t idx) {
+    return idx >= -1 && idx < (int64_t)noteCount;
+  };
+
+  for (uint64_t i = 0; i < noteCount; i++) {
+    if (!validNote(notes[i].prev) || !validNote(notes[i].next) || !validNote(notes[i].chordNext) ||
+        notes[i].key < -1 || notes[i].key >= (int64_t)keyCount ||
+        notes[i].track < 0 || notes[i].track >= trackCount || notes[i].channel < 0 || notes[i].channel > 15) {
+      logII(LL_WARN, "corrupt note links in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+  for (uint64_t i = 0; i < measureCount; i++) {
+    if (measures[i].noteStart < 0 || measures[i].noteCount < 0 ||
+        (uint64_t)measures[i].noteStart + measures[i].noteCount > measureNoteCount) {
+      logII(LL_WARN, "corrupt measure map in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+  for (uint64_t i = 0; i < measureNoteCount; i++) {
+    if (measureNotes[i] < 0 || measureNotes[i] >= (int64_t)noteCount) {
+      logII(LL_WARN, "corrupt measure map in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+  // segments are groups of 5 values led by their note
+  if (lineVertCount % 5) {
+    logII(LL_WARN, "corrupt line map in " + filename);
+    munmap(mapped, fileSize);
+    return false;
+  }
+  for (uint64_t i = 0; i < lineVertCount; i += 5) {
+    if (lineVerts[i] < 0 || lineVerts[i] >= (int64_t)noteCount) {
+      logII(LL_WARN, "corrupt line map in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+  for (uint64_t i = 0; i < heightCount; i++) {
+    if (heights[i].track < 0 || heights[i].track >= trackCount) {
+      logII(LL_WARN, "corrupt track heights in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+  // output sends these as they are, only program and controller changes belong here
+  for (uint64_t i = 0; i < controlCount; i++) {
+    uint8_t status = controls[i].data[0] & 0xF0;
+    if ((status != 0xB0 && status != 0xC0) || controls[i].data[1] > 0x7F || controls[i].data[2] > 0x7F) {
+      logII(LL_WARN, "corrupt channel events in " + filename);
+      munmap(mapped, fileSize);
+      return false;
+    }
+  }
+
+  file.clear();
+  file.trackCount = trackCount;
+  file.noteCount = noteCount;
+  file.tpq = header->tpq;
+  file.lastTick = header->lastTick;
+  file.lastTime = header->lastTime;
+  file.tracks.resize(file.trackCount);
+
+  for (uint64_t i = 0; i < header->sections[MKI_TEMPO].count; i++) {
+    file.tempoMap.push_back(make_pair(tempos[i].tick, tempos[i].bpm));
+  }
+  file.tickMap.assign(tickMap, tickMap + header->sections[MKI_TICK_MAP].count);
+  file.lineVerts.assign(lineVerts, lineVerts + lineVertCount);
+  for (uint64_t i = 0; i < heightCount; i++) {
+    file.trackHeightMap.push_back(make_pair(heights[i].track, heights[i].height));
+  }
+
+  // signatures are pushed directly, addTimeSignature would drop repeats
+  for (uint64_t i = 0; i < header->sections[MKI_TIMESIG].count; i++) {
+    timeSig ts(timeSigs[i].top, timeSigs[i].bottom, timeSigs[i].tick);
+    ts.setMeasure(timeSigs[i].measure);
+    file.sheetData.timeSignatureMap.push_back(make_pair(timeSigs[i].position, ts));
+  }
+  for (uint64_t i = 0; i < keyCount; i++) {
+    keySig ks(keySigs[i].key, keySigs[i].isMinor, keySigs[i].tick);
+    ks.setMeasure(keySigs[i].measure);
+    file.sheetData.keySignatureMap.push_back(make_pair(keySigs[i].position, ks));
+  }
+  file.sheetData.linkKeySignatures();
+  file.timing.build(file.tpq, file.tempoMap, file.sheetData);
+
+  // notes, links are already indices into the store
+  file.notes.resize(noteCount);
+  file.store.resize(noteCount);
+  note* first = file.notes.data();
+  for (uint64_t i = 0; i < noteCount; i++) {
+    note& n = file.notes[i];
+    n.size = notes[i].size;
+    n.tick = notes[i].tick;
+    n.tickDuration = notes[i].tickDuration;
+    n.measure = notes[i].measure;
+    n.key = notes[i].key < 0 ? nullptr : &file.sheetData.keySignatureMap[notes[i].key].second;
+
+    file.store.start[i] = notes[i].x;
+    file.store.duration[i] = notes[i].duration;
+    file.store.pitch[i] = notes[i].y;
+    file.store.track[i] = notes[i].track;
+    file.store.velocity[i] = notes[i].velocity;
+    file.store.channel[i] = notes[i].channel;
+    file.store.lastOnTrack[i] = notes[i].isLastOnTrack;
+    file.store.prev[i] = notes[i].prev;
+    file.store.next[i] = notes[i].next;
+    file.store.chordNext[i] = notes[i].chordNext;
+  }
+
+  for (uint64_t i = 0; i < controlCount; i++) {
+    file.store.controls.push_back({controls[i].time, {controls[i].data[0], controls[i].data[1], controls[i].data[2]}});
+  }
+
+  // measures, then rebuild their event lists from the restored pointers
+  for (uint64_t i = 0; i < measureCount; i++) {
+    file.measureMap.push_back(measureController(measures[i].location, measures[i].tick, measures[i].tickLength));
+    measureController& m = file.measureMap.back();
+    for (int j = 0; j < measures[i].noteCount; j++) {
+      m.notes.push_back(first + measureNotes[measures[i].noteStart + j]);
+    }
+  }
+  for (unsigned int i = 0; i < file.sheetData.timeSignatureMap.size(); i++) {
+    timeSig& ts = file.sheetData.timeSignatureMap[i].second;
+    if (ts.measure >= 0 && ts.measure < (int)measureCount) {
+      file.measureMap[ts.measure].timeSignatures.push_back(&ts);
+    }
+  }
+  for (unsigned int i = 0; i < file.sheetData.keySignatureMap.size(); i++) {
+    keySig& ks = file.sheetData.keySignatureMap[i].second;
+    if (ks.measure >= 0 && ks.measure < (int)measureCount) {
+      file.measureMap[ks.measure].keySignatures.push_back(&ks);
+    }
+  }
+  for (uint64_t i = 0; i < measureCount; i++) {
+    measureController& m = file.measureMap[i];
+    m.findLength();
+    m.length = measures[i].length;
+    m.parentMeasure = measures[i].parentMeasure;
+    m.displayX = measures[i].displayX;
+    m.displayLength = measures[i].displayLength;
+    m.expandRatio = measures[i].expandRatio;
+  }
+
+  if (header->sections[MKI_COLORS].count == (uint64_t)file.trackCount) {
+    on.clear();
+    off.clear();
+    for (int i = 0; i < file.trackCount; i++) {
+      on.push_back(colorRGB(colors[i].on[0], colors[i].on[1], colors[i].on[2]));
+      off.push_back(colorRGB(colors[i].off[0], colors[i].off[1], colors[i].off[2]));
+    }
+  }
+  else {
+    getColorScheme(file.trackCount, on, off, file.trackHeightMap);
+  }
+
+  munmap(mapped, fileSize);
+
+  file.buildIndex();
+
+  log3(LL_INFO, "loaded mki with notes", noteCount);
+  return true;
+}
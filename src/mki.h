@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "midi.h"
+#include "color.h"
+
+using std::string;
+using std::vector;
+
+#define MKI_MAGIC 0x314b4d4b // "KMK1"
+#define MKI_VERSION 3
+// the SMF header stores the track count in 16 bits
+#define MKI_MAX_TRACKS 65535
+
+enum mkiSections {
+  MKI_NOTES,
+  MKI_TEMPO,
+  MKI_TIMESIG,
+  MKI_KEYSIG,
+  MKI_MEASURES,
+  MKI_MEASURE_NOTES,
+  MKI_LINE_VERTS,
+  MKI_TRACK_HEIGHT,
+  MKI_TICK_MAP,
+  MKI_COLORS,
+  MKI_CONTROLS,
+  MKI_SECTION_COUNT
+};
+
+// every record is fixed size and 8 byte aligned so sections can be read in place
+
+struct mkiSection {
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct mkiHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t trackCount;
+  int32_t noteCount;
+  int32_t tpq;
+  int32_t lastTick;
+  double lastTime;
+  mkiSection sections[MKI_SECTION_COUNT];
+};
+
+struct mkiNote {
+  int32_t size;
+  int32_t tick;
+  int32_t tickDuration;
+  int32_t track;
+  int32_t measure;
+  int32_t y;
+  double duration;
+  double x;
+  int32_t velocity;
+  int32_t isLastOnTrack;
+  // links are stored as indices, -1 for none
+  int32_t prev;
+  int32_t next;
+  int32_t chordNext;
+  int32_t key;
+  int32_t channel;
+  int32_t pad;
+};
+
+struct mkiTempo {
+  double position;
+  double bpm;
+  int32_t tick;
+  int32_t pad;
+};
+
+struct mkiTimeSig {
+  int32_t position;
+  int32_t top;
+  int32_t bottom;
+  int32_t measure;
+  int32_t tick;
+  int32_t pad;
+};
+
+struct mkiKeySig {
+  int32_t position;
+  int32_t key;
+  int32_t isMinor;
+  int32_t measure;
+  int32_t tick;
+  int32_t pad;
+};
+
+struct mkiMeasure {
+  double location;
+  double expandRatio;
+  int32_t length;
+  int32_t tick;
+  int32_t tickLength;
+  int32_t parentMeasure;
+  int32_t displayX;
+  int32_t displayLength;
+  // range into the MKI_MEASURE_NOTES section
+  int32_t noteStart;
+  int32_t noteCount;
+};
+
+struct mkiTrackHeight {
+  int32_t track;
+  int32_t pad;
+  double height;
+};
+
+struct mkiColor {
+  double on[3];
+  double off[3];
+};
+
+struct mkiControl {
+  double time;
+  uint8_t data[3];
+  uint8_t pad[5];
+};
+
+class mkiFile {
+  public:
+    static bool save(const string& filename, midi& file, vector<colorRGB>& on, vector<colorRGB>& off);
+    static bool load(const string& filename, midi& file, vector<colorRGB>& on, vector<colorRGB>& off);
+};
+
+bool isMKI(const string& filename);
@@ -8,59 +8,29 @@ using std::vector;
 class note {
   public:
     note() {
-      number = -1;
       size = 0x00000000;
       tick = 0;
       tickDuration = 0;
-      track = 0;
       measure = 0;
-      duration = 0;
-      x = 0;
-      y = 0;
-      velocity = 0;
-      isOn = false;
-      isLastOnTrack = false;
-      prev = nullptr;
-      next = nullptr;
-      chordNext = nullptr;
       key = nullptr;
 
     }
 
-    note* getNextNote();
-    note* getNextChordRoot();
-    int getChordSize();
-    
     void setKeySig(keySig* ks) { key = ks; }
     keySig* getKeySig() { return key; };
 
-    bool isChordRoot();
-
     void findSize(vector<int>& noteChart);
-    void findSheetY();
     
-    int number;
     int size; 
     int tick;
     int tickDuration;
-    int track;
     int measure;
-    double duration;
-    double x;
-    int y;
-    int velocity;
-    bool isOn;
-    bool isLastOnTrack;
 
-    friend class trackController;
-    friend vector<int> getLinePositions(note* now, note* next);
+    // only what the sheet needs, notes share their index with noteStore where time, pitch,
+    // track, velocity and the playback links live, see store.h
+    friend class mkiFile;
 
   private:
-  
-    note* prev;
-    note* next;
-    note* chordNext;
-
     keySig* key;
 
 };
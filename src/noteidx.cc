@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+#include "noteidx.h"
+
+using std::sort;
+using std::max;
+using std::lower_bound;
+using std::upper_bound;
+
+void noteIndex::build(noteStore& store) {
+  clear();
+  pending.reserve(store.size());
+  for (int i = 0; i < store.size(); i++) {
+    add(i, store.start[i], store.start[i] + max(store.duration[i], 0.0));
+  }
+  finalize();
+}
+
+void noteIndex::add(int id, double start, double end) {
+  pending.push_back({start, max(start, end), id});
+}
+
+int noteIndex::findLevel(double length) {
+  // level k holds lengths in [2^k, 2^(k + 1)), level 0 also holds anything shorter
+  if (length < 2) {
+    return 0;
+  }
+  return static_cast<int>(std::log2(length));
+}
+
+void noteIndex::finalize() {
+  sort(pending.begin(), pending.end(), [](const entry& left, const entry& right) {
+    return left.start < right.start;
+  });
+
+  for (unsigned int i = 0; i < pending.size(); i++) {
+    int lv = findLevel(pending[i].end - pending[i].start);
+    if (lv >= (int)levels.size()) {
+      levels.resize(lv + 1, {0, {}, {}, {}});
+    }
+    levels[lv].maxLength = max(levels[lv].maxLength, pending[i].end - pending[i].start);
+    levels[lv].starts.push_back(pending[i].start);
+    levels[lv].ends.push_back(pending[i].end);
+    levels[lv].ids.push_back(pending[i].id);
+  }
+  size += pending.size();
+
+  pending.clear();
+  pending.shrink_to_fit();
+}
+
+void noteIndex::clear() {
+  levels.clear();
+  pending.clear();
+  size = 0;
+}
+
+void noteIndex::query(double start, double end, vector<int>& result) {
+  result.clear();
+  for (unsigned int lv = 0; lv < levels.size(); lv++) {
+    const level& l = levels[lv];
+    if (l.starts.empty()) {
+      continue;
+    }
+    // nothing in this level can reach back further than its longest entry
+    int first = lower_bound(l.starts.begin(), l.starts.end(), start - l.maxLength) - l.starts.begin();
+    int last = upper_bound(l.starts.begin(), l.starts.end(), end) - l.starts.begin();
+    for (int i = first; i < last; i++) {
+      if (l.ends[i] >= start) {
+        result.push_back(l.ids[i]);
+      }
+    }
+  }
+  // keep draw order identical to an unculled pass
+  sort(result.begin(), result.end());
+}
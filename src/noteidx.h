@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "store.h"
+
+using std::vector;
+
+// time index over [start, end] intervals, grouped into power-of-two
+// duration classes so long notes are still found from a start-sorted search
+class noteIndex {
+  public:
+    noteIndex() {
+      levels = {};
+      pending = {};
+    }
+
+    void build(noteStore& store);
+
+    void add(int id, double start, double end);
+    void finalize();
+    void clear();
+
+    void query(double start, double end, vector<int>& result);
+
+    int getSize() { return size; }
+
+  private:
+    struct entry {
+      double start;
+      double end;
+      int id;
+    };
+
+    struct level {
+      double maxLength;
+      vector<double> starts;
+      vector<double> ends;
+      vector<int> ids;
+    };
+
+    int findLevel(double length);
+
+    vector<level> levels;
+    vector<entry> pending;
+    int size = 0;
+};
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include "output.h"
+#include "log.h"
+
+using std::lower_bound;
+using std::max;
+using std::min;
+using std::greater;
+using std::priority_queue;
+using std::unique_lock;
+using std::lock_guard;
+using std::chrono::microseconds;
+
+midiOutput::midiOutput() : midiOut(nullptr), sink(nullptr), playing(false), stopping(false), store(nullptr), clock(),
+                           maxJitter(0) {
+  midiOut = new RtMidiOut();
+}
+
+midiOutput::~midiOutput() {
+  stop();
+  delete midiOut;
+}
+
+vector<string> midiOutput::getPorts() {
+  vector<string> ports;
+  int count = midiOut->getPortCount();
+  for (int i = 0; i < count; i++) {
+    ports.push_back(midiOut->getPortName(i));
+  }
+  ports.push_back("Virtual Port");
+  return ports;
+}
+
+void midiOutput::openPort(int port) {
+  stop();
+  midiOut->closePort();
+
+  int count = midiOut->getPortCount();
+  if (port == count) {
+    midiOut->openVirtualPort("kelumi");
+    logII(LL_INFO, "opened virtual output port");
+    return;
+  }
+  if (port < 0 || port > count) {
+    log3(LL_WARN, "unable to open output port number", port);
+    return;
+  }
+  midiOut->openPort(port);
+  log3(LL_INFO, "opened output port ", port);
+}
+
+void midiOutput::setSink(const function<void(const uint8_t*, int)>& fn) {
+  stop();
+  sink = fn;
+}
+
+void midiOutput::play(noteStore* notes, const transport& playback) {
+  stop();
+  if (notes == nullptr || !playback.isRunning() || !isPortOpen()) {
+    return;
+  }
+
+  store = notes;
+  clock = playback;
+  maxJitter = 0;
+  stopping = false;
+  playing = true;
+  worker = thread(&midiOutput::schedule, this);
+}
+
+void midiOutput::stop() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+  playing = false;
+}
+
+void midiOutput::send(const uint8_t* data, int size) {
+  if (sink) {
+    sink(data, size);
+    return;
+  }
+  midiOut->sendMessage(data, size);
+}
+
+void midiOutput::schedule() {
+  priority_queue<event, vector<event>, greater<event>> due;
+  long long order = 0;
+  int next = lower_bound(store->start.begin(), store->start.end(), clock.getAnchor()) - store->start.begin();
+  int count = store->size();
+
+  const vector<channelEvent>& controls = store->controls;
+  int control = lower_bound(controls.begin(), controls.end(), clock.getAnchor(),
+                            [](const channelEvent& c, double time) { return c.time < time; }) - controls.begin();
+  int controlCount = controls.size();
+
+  // starting mid song, each channel gets the last program and controller values it was given
+  vector<int> program(16, -1);
+  vector<int> controller(16 * 128, -1);
+  for (int i = 0; i < control; i++) {
+    int channel = controls[i].data[0] & 0x0F;
+    if ((controls[i].data[0] & 0xF0) == 0xC0) {
+      program[channel] = controls[i].data[1];
+    }
+    else {
+      controller[channel * 128 + (controls[i].data[1] & 0x7F)] = controls[i].data[2];
+    }
+  }
+  steady_clock::time_point begin = clock.toClock(clock.getAnchor());
+  for (int channel = 0; channel < 16; channel++) {
+    // controllers first, a bank select only applies to the program change after it
+    for (int number = 0; number < 128; number++) {
+      int value = controller[channel * 128 + number];
+      if (value != -1) {
+        due.push({begin, {uint8_t(0xB0 | channel), uint8_t(number), uint8_t(value)}, order++});
+      }
+    }
+    if (program[channel] != -1) {
+      due.push({begin, {uint8_t(0xC0 | channel), uint8_t(program[channel]), 0}, order++});
+    }
+  }
+
+  // earliest song time not yet moved into the schedule
+  auto upcoming = [&] {
+    double time = std::numeric_limits<double>::infinity();
+    if (next < count) {
+      time = store->start[next];
+    }
+    if (control < controlCount) {
+      time = min(time, controls[control].time);
+    }
+    return time;
+  };
+
+  unique_lock<mutex> guard(lock);
+  while (!stopping) {
+    // move notes about to start into the schedule, their note offs wait there until due
+    double horizon = clock.getTime() + OUTPUT_LOOKAHEAD * clock.getRate();
+    for (; control < controlCount && controls[control].time < horizon; control++) {
+      const uint8_t* data = controls[control].data;
+      due.push({clock.toClock(controls[control].time), {data[0], data[1], data[2]}, order++});
+    }
+    for (; next < count && store->start[next] < horizon; next++) {
+      uint8_t channel = store->channel[next] & 0x0F;
+      uint8_t velocity = max(int(store->velocity[next]), 1);
+      double end = store->start[next] + max(store->duration[next], 0.0);
+      due.push({clock.toClock(store->start[next]), {uint8_t(0x90 | channel), store->pitch[next], velocity}, order++});
+      due.push({clock.toClock(end), {uint8_t(0x80 | channel), store->pitch[next], 0}, order++});
+    }
+
+    if (due.empty() && next >= count && control >= controlCount) {
+      break;
+    }
+
+    // a long note off can be due after the next notes need scheduling
+    if (next < count || control < controlCount) {
+      steady_clock::time_point refill = clock.toClock(upcoming() - OUTPUT_LOOKAHEAD * clock.getRate());
+      if (due.empty() || refill < due.top().due - microseconds(OUTPUT_SPIN)) {
+        wake.wait_until(guard, refill, [&] { return stopping; });
+        continue;
+      }
+    }
+
+    // sleep most of the way, then spin so the wakeup lands within the batch window
+    steady_clock::time_point target = due.top().due;
+    if (wake.wait_until(guard, target - microseconds(OUTPUT_SPIN), [&] { return stopping; })) {
+      break;
+    }
+    guard.unlock();
+    while (steady_clock::now() < target) {
+      std::this_thread::yield();
+    }
+
+    steady_clock::time_point now = steady_clock::now();
+    while (!due.empty() && due.top().due <= now + microseconds(OUTPUT_BATCH)) {
+      long long late = duration_cast<microseconds>(steady_clock::now() - due.top().due).count();
+      if (late > maxJitter) {
+        maxJitter = late;
+      }
+      send(due.top().data, due.top().size());
+      due.pop();
+    }
+    guard.lock();
+  }
+  guard.unlock();
+
+  // notes cut off by a stop would otherwise hang
+  if (!due.empty()) {
+    for (uint8_t channel = 0; channel < 16; channel++) {
+      uint8_t allOff[3] = {uint8_t(0xB0 | channel), 123, 0};
+      send(allOff, 3);
+    }
+  }
+  playing = false;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../dpd/rtmidi/RtMidi.h"
+#include "store.h"
+#include "transport.h"
+
+using std::atomic;
+using std::condition_variable;
+using std::function;
+using std::mutex;
+using std::string;
+using std::thread;
+using std::vector;
+using std::chrono::steady_clock;
+
+// how far ahead of the clock notes are moved into the schedule, in time units (1/500 s) at normal speed
+#define OUTPUT_LOOKAHEAD 10
+// events due this close together are sent in one wakeup, in microseconds
+#define OUTPUT_BATCH 200
+// the scheduler sleeps until this long before an event, then spins, in microseconds
+#define OUTPUT_SPIN 1000
+// latest a message may go out and still meet the playback target, in microseconds
+#define OUTPUT_JITTER_TARGET 1000
+
+// plays a note store to a MIDI output port from its own thread
+class midiOutput {
+  public:
+    midiOutput();
+    ~midiOutput();
+
+    // port names, the last entry opens a virtual port other programs can connect to
+    vector<string> getPorts();
+    void openPort(int port);
+    bool isPortOpen() { return sink || midiOut->isPortOpen(); }
+    // sends to fn instead of the port, e.g. to record what would have been played
+    void setSink(const function<void(const uint8_t*, int)>& fn);
+
+    // sends every note and channel event of store from where a running clock was started, programs and
+    // controllers set before that point go out first, store must not change until stop, and the clock
+    // is copied so play again after moving it
+    void play(noteStore* store, const transport& clock);
+    void stop();
+    bool isPlaying() { return playing; }
+
+    // latest any message has gone out since play, in microseconds
+    long long getMaxJitter() { return maxJitter; }
+
+  private:
+    struct event {
+      steady_clock::time_point due;
+      uint8_t data[3];
+      // ties keep the order events were scheduled in, a bank select stays ahead of its program change
+      long long order;
+
+      // note offs go first so a repeated key is not cut short, then program and controller changes
+      // so a note starting with them already hears them
+      int rank() const {
+        uint8_t status = data[0] & 0xF0;
+        return status == 0x80 ? 0 : status == 0x90 ? 2 : 1;
+      }
+      int size() const { return (data[0] & 0xF0) == 0xC0 ? 2 : 3; }
+      bool operator>(const event& other) const {
+        if (due != other.due) {
+          return due > other.due;
+        }
+        return rank() != other.rank() ? rank() > other.rank() : order > other.order;
+      }
+    };
+
+    void schedule();
+    void send(const uint8_t* data, int size);
+
+    RtMidiOut* midiOut;
+    function<void(const uint8_t*, int)> sink;
+
+    thread worker;
+    mutex lock;
+    condition_variable wake;
+    atomic<bool> playing;
+    bool stopping;
+
+    noteStore* store;
+    transport clock;
+    atomic<long long> maxJitter;
+};
@@ -0,0 +1,36 @@
+#include <algorithm>
+#include "pickidx.h"
+
+using std::min;
+using std::max;
+using std::sort;
+
+void pickIndex::build(noteStore& store) {
+  clear();
+  lanes.resize(PICK_LANES);
+  for (int i = 0; i < store.size(); i++) {
+    lanes[store.pitch[i] % PICK_LANES].add(i, store.start[i], store.start[i] + max(store.duration[i], 0.0));
+  }
+  for (unsigned int i = 0; i < lanes.size(); i++) {
+    lanes[i].finalize();
+  }
+}
+
+void pickIndex::clear() {
+  lanes.clear();
+}
+
+void pickIndex::query(int lowPitch, int highPitch, double start, double end, vector<int>& result) {
+  result.clear();
+  if (lanes.empty()) {
+    return;
+  }
+  lowPitch = max(lowPitch, 0);
+  highPitch = min(highPitch, PICK_LANES - 1);
+  for (int p = lowPitch; p <= highPitch; p++) {
+    lanes[p].query(start, end, laneResult);
+    result.insert(result.end(), laneResult.begin(), laneResult.end());
+  }
+  // lanes come back one after another, overlapping notes of different pitches must not follow lane order
+  sort(result.begin(), result.end());
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "noteidx.h"
+#include "store.h"
+
+using std::vector;
+
+#define PICK_LANES 128
+
+// interval index per pitch lane, finds the few notes near the cursor
+// so hover tests run on a handful of candidates instead of every note
+class pickIndex {
+  public:
+    pickIndex() {
+      lanes = {};
+    }
+
+    void build(noteStore& store);
+    void clear();
+
+    // ids of notes in pitches [lowPitch, highPitch] overlapping [start, end], in note order,
+    // which is draw order, so the last hit among them is the topmost note
+    void query(int lowPitch, int highPitch, double start, double end, vector<int>& result);
+
+  private:
+    vector<noteIndex> lanes;
+    vector<int> laneResult;
+};
+
+// everything a hover pick depends on, a pick is reused while this is unchanged
+struct pickState {
+  int mouseX;
+  int mouseY;
+  double timeOffset;
+  double zoom;
+  int displayMode;
+  int width;
+  int height;
+  int barHeight;
+  noteStore* store;
+  int noteCount;
+
+  bool operator== (const pickState& other) const {
+    return mouseX == other.mouseX && mouseY == other.mouseY && timeOffset == other.timeOffset &&
+           zoom == other.zoom && displayMode == other.displayMode && width == other.width &&
+           height == other.height && barHeight == other.barHeight && store == other.store &&
+           noteCount == other.noteCount;
+  }
+};
@@ -0,0 +1,152 @@
+#include <cstring>
+#include "png.h"
+#include "log.h"
+
+// IDAT chunks are emitted whenever this much compressed data is ready
+#define PNG_CHUNK_SIZE (1 << 18)
+
+static void putBigEndian(unsigned char* out, unsigned int value) {
+  out[0] = value >> 24;
+  out[1] = value >> 16;
+  out[2] = value >> 8;
+  out[3] = value;
+}
+
+bool pngWriter::open(const string& filename, int imageWidth, int imageHeight) {
+  close();
+  failed = false;
+  width = imageWidth;
+  height = imageHeight;
+  rows = 0;
+
+  if (width <= 0 || height <= 0) {
+    logII(LL_WARN, "invalid image size");
+    return false;
+  }
+
+  file = fopen(filename.c_str(), "wb");
+  if (file == nullptr) {
+    logII(LL_WARN, "unable to open image: " + filename);
+    return false;
+  }
+
+  stream = {};
+  if (deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    logII(LL_WARN, "unable to start PNG compression");
+    fclose(file);
+    file = nullptr;
+    return false;
+  }
+  buffer.resize(PNG_CHUNK_SIZE);
+  filtered.resize(width * 3 + 1);
+
+  const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+  failed = fwrite(signature, 1, sizeof(signature), file) != sizeof(signature);
+
+  // 8 bit truecolor, no interlacing
+  unsigned char header[13] = {};
+  putBigEndian(header, width);
+  putBigEndian(header + 4, height);
+  header[8] = 8;
+  header[9] = 2;
+  writeChunk("IHDR", header, sizeof(header));
+
+  stream.next_out = buffer.data();
+  stream.avail_out = buffer.size();
+  return !failed;
+}
+
+bool pngWriter::writeRows(const unsigned char* data, int count) {
+  if (file == nullptr || failed) {
+    return false;
+  }
+  if (rows + count > height) {
+    logII(LL_WARN, "too many PNG rows");
+    count = height - rows;
+  }
+
+  int stride = width * 3;
+  for (int r = 0; r < count; r++) {
+    // sub filter, flat runs of color become zeros and compress well
+    const unsigned char* row = data + r * stride;
+    filtered[0] = 1;
+    memcpy(&filtered[1], row, 3);
+    for (int i = 3; i < stride; i++) {
+      filtered[i + 1] = row[i] - row[i - 3];
+    }
+
+    stream.next_in = filtered.data();
+    stream.avail_in = filtered.size();
+    if (!compress(Z_NO_FLUSH)) {
+      return false;
+    }
+  }
+  rows += count;
+  return true;
+}
+
+bool pngWriter::compress(int flush) {
+  while (true) {
+    int status = deflate(&stream, flush);
+    if (status == Z_STREAM_ERROR) {
+      failed = true;
+      return false;
+    }
+
+    // flush full buffers, and whatever is left once the stream ends
+    if (!stream.avail_out || (status == Z_STREAM_END && stream.avail_out != buffer.size())) {
+      writeChunk("IDAT", buffer.data(), buffer.size() - stream.avail_out);
+      stream.next_out = buffer.data();
+      stream.avail_out = buffer.size();
+    }
+
+    if (flush == Z_FINISH ? status == Z_STREAM_END : !stream.avail_in && stream.avail_out) {
+      return !failed;
+    }
+  }
+}
+
+bool pngWriter::writeChunk(const char* type, const unsigned char* data, unsigned int size) {
+  unsigned char length[4];
+  unsigned char crc[4];
+  putBigEndian(length, size);
+
+  uLong check = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+  if (size) {
+    // a null buffer would reset the crc
+    check = crc32(check, data, size);
+  }
+  putBigEndian(crc, check);
+
+  if (fwrite(length, 1, 4, file) != 4 || fwrite(type, 1, 4, file) != 4 ||
+      fwrite(data, 1, size, file) != size || fwrite(crc, 1, 4, file) != 4) {
+    failed = true;
+  }
+  return !failed;
+}
+
+bool pngWriter::close() {
+  if (file == nullptr) {
+    return false;
+  }
+
+  if (rows < height) {
+    logII(LL_WARN, "PNG ended early");
+    failed = true;
+  }
+  if (!failed) {
+    stream.next_in = nullptr;
+    stream.avail_in = 0;
+    compress(Z_FINISH);
+    writeChunk("IEND", nullptr, 0);
+  }
+  deflateEnd(&stream);
+
+  if (fclose(file)) {
+    failed = true;
+  }
+  file = nullptr;
+  buffer.clear();
+  filtered.clear();
+  return !failed;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using std::string;
+using std::vector;
+
+// streaming RGB PNG encoder, rows are compressed as they arrive so the whole image never sits in memory
+class pngWriter {
+  public:
+    pngWriter() {
+      buffer = {};
+      filtered = {};
+      stream = {};
+      file = nullptr;
+      width = 0;
+      height = 0;
+      rows = 0;
+      failed = false;
+    }
+    ~pngWriter() {
+      close();
+    }
+
+    bool open(const string& filename, int imageWidth, int imageHeight);
+    // rows are packed RGB, top to bottom
+    bool writeRows(const unsigned char* data, int count);
+    // false if anything failed or fewer rows than the image height were written
+    bool close();
+
+    bool isOpen() { return file != nullptr; }
+
+  private:
+    bool writeChunk(const char* type, const unsigned char* data, unsigned int size);
+    bool compress(int flush);
+
+    vector<unsigned char> buffer;
+    vector<unsigned char> filtered;
+    z_stream stream;
+    FILE* file;
+
+    int width;
+    int height;
+    int rows;
+    bool failed;
+};
@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include "pool.h"
+#include "stats.h"
+
+using std::atomic;
+using std::min;
+using std::max;
+using std::unique_lock;
+using std::lock_guard;
+using std::shared_ptr;
+using std::make_shared;
+
+threadPool::threadPool(int threads) {
+  stopping = false;
+  if (threads <= 0) {
+    threads = max(static_cast<int>(thread::hardware_concurrency()) - 1, 1);
+  }
+  for (int i = 0; i < threads; i++) {
+    workers.push_back(thread(&threadPool::work, this));
+  }
+}
+
+threadPool::~threadPool() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+void threadPool::work() {
+  while (true) {
+    function<void()> task;
+    {
+      unique_lock<mutex> guard(lock);
+      wake.wait(guard, [this] { return stopping || !tasks.empty(); });
+      if (stopping && tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+
+void threadPool::parallelFor(int count, int grain, const function<void(int, int)>& fn) {
+  if (count <= 0) {
+    return;
+  }
+  grain = max(grain, 1);
+  int chunks = (count + grain - 1) / grain;
+  if (chunks == 1) {
+    fn(0, count);
+    return;
+  }
+
+  // chunks are claimed from a shared counter, so helpers that start late just find nothing left
+  struct loopState {
+    atomic<int> next;
+    atomic<int> finished;
+    mutex lock;
+    condition_variable done;
+  };
+  shared_ptr<loopState> state = make_shared<loopState>();
+  state->next = 0;
+  state->finished = 0;
+
+  // helpers charge their allocations to the caller, so its load stages count the whole loop
+  allocationCounter* owner = getAllocationCounter();
+  const auto runChunks = [state, chunks, count, grain, &fn, owner] {
+    allocationScope charge(owner);
+    int chunk;
+    while ((chunk = state->next++) < chunks) {
+      fn(chunk * grain, min((chunk + 1) * grain, count));
+      if (++state->finished == chunks) {
+        lock_guard<mutex> guard(state->lock);
+        state->done.notify_all();
+      }
+    }
+  };
+
+  int helpers = min(chunks - 1, static_cast<int>(workers.size()));
+  {
+    lock_guard<mutex> guard(lock);
+    for (int i = 0; i < helpers; i++) {
+      tasks.push_back(runChunks);
+    }
+  }
+  wake.notify_all();
+
+  runChunks();
+
+  unique_lock<mutex> guard(state->lock);
+  state->done.wait(guard, [&] { return state->finished == chunks; });
+}
+
+void threadPool::submit(const function<void()>& task) {
+  {
+    lock_guard<mutex> guard(lock);
+    tasks.push_back(task);
+  }
+  wake.notify_one();
+}
+
+threadPool& getThreadPool() {
+  static threadPool pool;
+  return pool;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::condition_variable;
+using std::deque;
+using std::function;
+using std::mutex;
+using std::thread;
+using std::vector;
+
+// fixed set of worker threads for splitting independent loop iterations across cores
+class threadPool {
+  public:
+    // zero picks one worker per hardware thread, minus the caller
+    threadPool(int threads = 0);
+    ~threadPool();
+
+    // calls fn(begin, end) on chunks of [0, count) of at most grain iterations,
+    // the calling thread helps out and it returns once every chunk has run
+    void parallelFor(int count, int grain, const function<void(int, int)>& fn);
+    // queues a task to run on a worker without waiting for it
+    void submit(const function<void()>& task);
+
+    int getThreadCount() { return workers.size() + 1; }
+
+  private:
+    void work();
+
+    vector<thread> workers;
+    deque<function<void()>> tasks;
+    mutex lock;
+    condition_variable wake;
+    bool stopping;
+};
+
+// pool shared by the loaders, created on first use
+threadPool& getThreadPool();
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include "profile.h"
+#include "wrap.h"
+#include "log.h"
+
+using std::max;
+using std::min;
+using std::replace;
+using std::to_string;
+
+frameProfiler profiler;
+
+namespace {
+  const char* phaseNames[PHASE_COUNT] = {"input", "measures", "bars", "lines", "balls", "sheet", "menus"};
+  const char* counterNames[COUNTER_COUNT] = {"visited", "culled", "drawn", "draw calls"};
+
+  int findBucket(double ms) {
+    int bucket = 0;
+    for (double limit = 0.125; bucket < PROFILE_BUCKETS - 1 && ms >= limit; limit *= 2) {
+      bucket++;
+    }
+    return bucket;
+  }
+
+  string formatMs(double ms) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%.2f", ms);
+    return buffer;
+  }
+}
+
+void frameProfiler::beginFrame() {
+  current = {};
+  frameStart = steady_clock::now();
+}
+
+void frameProfiler::endFrame() {
+  current.frameMs = std::chrono::duration<double, std::milli>(steady_clock::now() - frameStart).count();
+  history[head] = current;
+  head = (head + 1) % PROFILE_FRAMES;
+  frames = min(frames + 1, PROFILE_FRAMES);
+
+  if (csv != nullptr) {
+    fprintf(csv, "%lld,%.4f", frameNumber, current.frameMs);
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      fprintf(csv, ",%.4f", current.phases[p]);
+    }
+    for (int c = 0; c < COUNTER_COUNT; c++) {
+      fprintf(csv, ",%lld", current.counts[c]);
+    }
+    fprintf(csv, "\n");
+  }
+  frameNumber++;
+}
+
+bool frameProfiler::startCSV(const string& filename) {
+  stopCSV();
+  csv = fopen(filename.c_str(), "w");
+  if (csv == nullptr) {
+    logII(LL_WARN, "unable to write profile: " + filename);
+    return false;
+  }
+
+  fprintf(csv, "frame,frame_ms");
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    fprintf(csv, ",%s_ms", phaseNames[p]);
+  }
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    string name = counterNames[c];
+    replace(name.begin(), name.end(), ' ', '_');
+    fprintf(csv, ",%s", name.c_str());
+  }
+  fprintf(csv, "\n");
+  logII(LL_INFO, "recording profile to " + filename);
+  return true;
+}
+
+void frameProfiler::stopCSV() {
+  if (csv != nullptr) {
+    fclose(csv);
+  }
+  csv = nullptr;
+}
+
+void frameProfiler::draw(Font ft, int x, int y, colorRGB fg, colorRGB bg) {
+  const int rowHeight = ft.baseSize + 4;
+  const int nameWidth = 64;
+  const int numberWidth = 48;
+  const int barWidth = 6;
+  const int width = nameWidth + 2 * numberWidth + PROFILE_BUCKETS * barWidth + 12;
+  const int height = (PHASE_COUNT + COUNTER_COUNT + 2) * rowHeight + 8;
+  x -= width;
+
+  drawRectangle(x, y, width, height, bg);
+  drawTextEx(ft, "phase", x + 4, y + 4, fg);
+  drawTextEx(ft, "avg ms", x + 4 + nameWidth, y + 4, fg);
+  drawTextEx(ft, "max ms", x + 4 + nameWidth + numberWidth, y + 4, fg);
+
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    int rowY = y + 4 + (p + 1) * rowHeight;
+    int buckets[PROFILE_BUCKETS] = {};
+    double total = 0;
+    double worst = 0;
+    for (int f = 0; f < frames; f++) {
+      double ms = history[f].phases[p];
+      buckets[findBucket(ms)]++;
+      total += ms;
+      worst = max(worst, ms);
+    }
+
+    drawTextEx(ft, phaseNames[p], x + 4, rowY, fg);
+    drawTextEx(ft, formatMs(frames ? total / frames : 0), x + 4 + nameWidth, rowY, fg);
+    drawTextEx(ft, formatMs(worst), x + 4 + nameWidth + numberWidth, rowY, fg);
+
+    // share of recent frames in each time bucket, left is fastest
+    int graphX = x + 4 + nameWidth + 2 * numberWidth;
+    for (int b = 0; b < PROFILE_BUCKETS; b++) {
+      int barHeight = frames ? (rowHeight - 2) * buckets[b] / frames : 0;
+      drawRectangle(graphX + b * barWidth, rowY + rowHeight - 2 - barHeight, barWidth - 1, max(barHeight, 1), fg);
+    }
+  }
+
+  // counters are from the last complete frame
+  const frame& last = history[(head + PROFILE_FRAMES - 1) % PROFILE_FRAMES];
+  int rowY = y + 4 + (PHASE_COUNT + 1) * rowHeight;
+  drawTextEx(ft, "frame " + formatMs(last.frameMs) + " ms", x + 4, rowY, fg);
+  for (int c = 0; c < COUNTER_COUNT; c++) {
+    rowY += rowHeight;
+    drawTextEx(ft, counterNames[c], x + 4, rowY, fg);
+    drawTextEx(ft, to_string(last.counts[c]), x + 4 + nameWidth + numberWidth, rowY, fg);
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <raylib.h>
+#include "color.h"
+
+using std::string;
+using std::vector;
+using std::chrono::steady_clock;
+
+// frames kept for the overlay
+#define PROFILE_FRAMES 240
+// overlay histogram buckets, bucket k holds times under 2^(k - 3) ms
+#define PROFILE_BUCKETS 10
+// where per-frame records go while recording
+#define PROFILE_CSV "profile.csv"
+
+enum profilePhase {
+  PHASE_INPUT,
+  PHASE_MEASURES,
+  PHASE_NOTE_BAR,
+  PHASE_NOTE_LINE,
+  PHASE_NOTE_BALL,
+  PHASE_SHEET,
+  PHASE_MENUS,
+  PHASE_COUNT
+};
+
+enum profileCounter {
+  COUNT_VISITED,   // notes or segments returned by the visibility query
+  COUNT_CULLED,    // notes or segments the query skipped
+  COUNT_DRAWN,
+  COUNT_DRAWCALLS, // calls into raylib drawing
+  COUNTER_COUNT
+};
+
+// per-frame timings of the main loop phases and a few counters
+class frameProfiler {
+  public:
+    frameProfiler() {
+      current = {};
+      history = vector<frame>(PROFILE_FRAMES, frame{});
+      head = 0;
+      frames = 0;
+      frameNumber = 0;
+      csv = nullptr;
+    }
+    ~frameProfiler() {
+      stopCSV();
+    }
+
+    void beginFrame();
+    void endFrame();
+
+    void addTime(int phase, double ms) { current.phases[phase] += ms; }
+    void count(int counter, long long n = 1) { current.counts[counter] += n; }
+
+    // one row per frame until stopped
+    bool startCSV(const string& filename);
+    void stopCSV();
+    bool isRecording() { return csv != nullptr; }
+
+    // timing histograms of the last PROFILE_FRAMES frames with x, y as the top right corner
+    void draw(Font ft, int x, int y, colorRGB fg, colorRGB bg);
+
+  private:
+    struct frame {
+      double frameMs;
+      double phases[PHASE_COUNT];
+      long long counts[COUNTER_COUNT];
+    };
+
+    frame current;
+    vector<frame> history;
+    int head;
+    int frames;
+    long long frameNumber;
+    steady_clock::time_point frameStart;
+    FILE* csv;
+};
+
+extern frameProfiler profiler;
+
+// times the enclosing block, or up to end() if called first
+class profileScope {
+  public:
+    profileScope(int timedPhase) {
+      phase = timedPhase;
+      start = steady_clock::now();
+    }
+    ~profileScope() {
+      end();
+    }
+
+    void end() {
+      if (phase != -1) {
+        profiler.addTime(phase, std::chrono::duration<double, std::milli>(steady_clock::now() - start).count());
+        phase = -1;
+      }
+    }
+
+  private:
+    int phase;
+    steady_clock::time_point start;
+};
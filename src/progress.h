@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+
+using std::atomic;
+
+enum loadStages {
+  LOAD_PARSE,
+  LOAD_NOTES,
+  LOAD_MEASURES,
+  LOAD_LAYOUT,
+  LOAD_LINES,
+  LOAD_STAGE_COUNT
+};
+
+// shared between a loading thread and the render thread
+struct loadProgress {
+  loadProgress() {
+    stage = LOAD_PARSE;
+    fraction = 0;
+    cancel = false;
+  }
+
+  atomic<int> stage;
+  atomic<float> fraction;
+  atomic<bool> cancel;
+};
@@ -0,0 +1,147 @@
+#include <cerrno>
+#include <cstdlib>
+#include <sys/stat.h>
+#include "render.h"
+#include "pool.h"
+#include "log.h"
+
+using std::unique_lock;
+using std::lock_guard;
+
+bool parseRenderArgs(int argc, char* argv[], renderSettings& settings) {
+  settings = {"", "", RENDER_DEFAULT_WIDTH, RENDER_DEFAULT_HEIGHT, RENDER_DEFAULT_FPS, RENDER_PNG};
+
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+
+    if (arg == "--render" && hasValue) {
+      settings.output = argv[++i];
+    }
+    else if (arg == "--size" && hasValue) {
+      if (sscanf(argv[++i], "%dx%d", &settings.width, &settings.height) != 2) {
+        logII(LL_WARN, "invalid render size: " + string(argv[i]));
+        return false;
+      }
+    }
+    else if (arg == "--fps" && hasValue) {
+      settings.fps = atoi(argv[++i]);
+    }
+    else if (arg == "--raw") {
+      settings.format = RENDER_RAW;
+    }
+    else if (arg.compare(0, 2, "--")) {
+      settings.input = arg;
+    }
+    else {
+      logII(LL_WARN, "unknown argument: " + arg);
+    }
+  }
+
+  if (settings.output.empty()) {
+    return false;
+  }
+  if (settings.input.empty() || settings.width <= 0 || settings.height <= 0 || settings.fps <= 0) {
+    logII(LL_WARN, "usage: kelumi <file> --render <output> [--size WxH] [--fps N] [--raw]");
+    return false;
+  }
+  return true;
+}
+
+bool frameWriter::open(const renderSettings& settings) {
+  close();
+  output = settings.output;
+  format = settings.format;
+  frameCount = 0;
+  failed = false;
+
+  if (format == RENDER_RAW) {
+    raw = output == "-" ? stdout : fopen(output.c_str(), "wb");
+    if (raw == nullptr) {
+      logII(LL_WARN, "unable to open render output: " + output);
+      return false;
+    }
+    rgb.resize(settings.width * settings.height * 3);
+    return true;
+  }
+
+  if (mkdir(output.c_str(), 0755) && errno != EEXIST) {
+    logII(LL_WARN, "unable to create render directory: " + output);
+    return false;
+  }
+  maxPending = getThreadPool().getThreadCount() * 2;
+  return true;
+}
+
+bool frameWriter::write(Image frame) {
+  if (failed || frame.data == nullptr) {
+    UnloadImage(frame);
+    return false;
+  }
+  int number = frameCount++;
+
+  if (format == RENDER_RAW) {
+    // drop alpha and flip rows while packing, rows are stored bottom up
+    const unsigned char* pixels = static_cast<const unsigned char*>(frame.data);
+    rgb.resize(frame.width * frame.height * 3);
+    unsigned char* out = rgb.data();
+    for (int y = frame.height - 1; y >= 0; y--) {
+      const unsigned char* row = pixels + y * frame.width * 4;
+      for (int x = 0; x < frame.width; x++) {
+        *out++ = row[x * 4];
+        *out++ = row[x * 4 + 1];
+        *out++ = row[x * 4 + 2];
+      }
+    }
+    UnloadImage(frame);
+
+    if (fwrite(rgb.data(), 1, rgb.size(), raw) != rgb.size()) {
+      logII(LL_WARN, "unable to write raw frame");
+      failed = true;
+    }
+    return !failed;
+  }
+
+  {
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [this] { return pending < maxPending; });
+    pending++;
+  }
+  getThreadPool().submit([this, frame, number] {
+    encode(frame, number);
+  });
+  return !failed;
+}
+
+void frameWriter::encode(Image frame, int number) {
+  char name[16];
+  snprintf(name, sizeof(name), "/%06d.png", number);
+
+  ImageFlipVertical(&frame);
+  if (!ExportImage(frame, (output + name).c_str())) {
+    failed = true;
+  }
+  UnloadImage(frame);
+
+  lock_guard<mutex> guard(lock);
+  pending--;
+  drained.notify_all();
+}
+
+void frameWriter::close() {
+  {
+    unique_lock<mutex> guard(lock);
+    drained.wait(guard, [this] { return pending == 0; });
+  }
+
+  if (raw != nullptr) {
+    fflush(raw);
+    if (raw != stdout) {
+      fclose(raw);
+    }
+    raw = nullptr;
+  }
+  if (failed && format == RENDER_PNG) {
+    logII(LL_WARN, "unable to write frames to " + output);
+  }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <raylib.h>
+
+using std::atomic;
+using std::condition_variable;
+using std::mutex;
+using std::string;
+using std::vector;
+
+#define RENDER_DEFAULT_WIDTH 1920
+#define RENDER_DEFAULT_HEIGHT 1080
+#define RENDER_DEFAULT_FPS 60
+
+enum renderFormats {
+  RENDER_PNG,
+  RENDER_RAW
+};
+
+// offline render job, filled from the command line
+struct renderSettings {
+  string input;
+  string output;
+  int width;
+  int height;
+  int fps;
+  int format;
+};
+
+// kelumi <file> --render <output> [--size WxH] [--fps N] [--raw]
+// returns false when the arguments do not ask for a render
+bool parseRenderArgs(int argc, char* argv[], renderSettings& settings);
+
+// sink for rendered frames, raw RGB goes out in order on the caller's thread,
+// numbered PNGs are encoded on the thread pool
+class frameWriter {
+  public:
+    frameWriter() {
+      rgb = {};
+      output = "";
+      raw = nullptr;
+      format = RENDER_PNG;
+      frameCount = 0;
+      pending = 0;
+      maxPending = 0;
+      failed = false;
+    }
+    ~frameWriter() {
+      close();
+    }
+
+    // output is a directory for PNGs, a file or "-" for stdout for raw frames
+    bool open(const renderSettings& settings);
+    // takes ownership of a frame read back from a render texture, which is upside down
+    bool write(Image frame);
+    // waits for every queued frame
+    void close();
+
+    int getFrameCount() { return frameCount; }
+
+  private:
+    void encode(Image frame, int number);
+
+    vector<unsigned char> rgb;
+    string output;
+    FILE* raw;
+    int format;
+    int frameCount;
+
+    // PNGs waiting on the pool, bounded so frames do not pile up in memory
+    int pending;
+    int maxPending;
+    mutex lock;
+    condition_variable drained;
+    atomic<bool> failed;
+};
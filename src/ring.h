@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+
+using std::atomic;
+
+// fixed size queue for one producer thread and one consumer thread, neither side locks or blocks
+// SIZE must be a power of two
+template <typename T, unsigned int SIZE>
+class spscRing {
+  public:
+    spscRing() {
+      head = 0;
+      tail = 0;
+    }
+
+    // producer side, false when full
+    bool push(const T& item) {
+      unsigned int back = tail.load(std::memory_order_relaxed);
+      if (back - head.load(std::memory_order_acquire) == SIZE) {
+        return false;
+      }
+      items[back & (SIZE - 1)] = item;
+      tail.store(back + 1, std::memory_order_release);
+      return true;
+    }
+
+    // consumer side, false when empty
+    bool pop(T& item) {
+      unsigned int front = head.load(std::memory_order_relaxed);
+      if (front == tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      item = items[front & (SIZE - 1)];
+      head.store(front + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool empty() { return head.load() == tail.load(); }
+
+  private:
+    static_assert(SIZE && !(SIZE & (SIZE - 1)), "ring size must be a power of two");
+
+    T items[SIZE];
+    // kept on separate cache lines so the two threads do not share one
+    alignas(64) atomic<unsigned int> head;
+    alignas(64) atomic<unsigned int> tail;
+};
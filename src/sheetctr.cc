@@ -1,5 +1,7 @@
 #include "sheetctr.h"
 
+using std::upper_bound;
+
 void sheetController::addTimeSignature(int position, int tick, timeSig timeSignature) {
   if (timeSignatureMap.size() != 0 && timeSignatureMap[timeSignatureMap.size()-1].second == timeSignature) {
     return;
@@ -75,22 +77,25 @@ keySig sheetController::eventToKeySignature(int keySigType, bool isMinor) {
 
 timeSig sheetController::getTimeSignature(int offset) {
   timeSig timeSignature = {0, -1, 1};
-  for (unsigned int i = 0; i < timeSignatureMap.size(); i++) {
-    if (offset > timeSignatureMap[i].first && offset < timeSignatureMap[i + 1].first) {
-      return timeSignatureMap[i].second;
-    }
+  // maps are ordered by position
+  auto it = upper_bound(timeSignatureMap.begin(), timeSignatureMap.end(), offset, [](int value, const pair<int, timeSig>& sig) {
+    return value < sig.first;
+  });
+  if (it == timeSignatureMap.begin()) {
+    return timeSignature;
   }
-  return timeSignature;
+  return (it - 1)->second;
 }
 
 keySig sheetController::getKeySignature(int offset) {
   keySig keySignature = {0, 1, -1};
-  for (unsigned int i = 0; i < keySignatureMap.size(); i++) {
-    if (offset > keySignatureMap[i].first && offset < keySignatureMap[i + 1].first) {
-      return keySignatureMap[i].second;
-    }
+  auto it = upper_bound(keySignatureMap.begin(), keySignatureMap.end(), offset, [](int value, const pair<int, keySig>& sig) {
+    return value < sig.first;
+  });
+  if (it == keySignatureMap.begin()) {
+    return keySignature;
   }
-  return keySignature;
+  return (it - 1)->second;
 }
 
 void sheetController::reset() {
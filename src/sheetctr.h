@@ -30,6 +30,8 @@ class sheetController {
     keySig eventToKeySignature(int keySigType, bool isMinor);
 
     friend class midi;
+    friend class mkiFile;
+    friend class timeline;
 
   private:
     vector<pair<int, timeSig>> timeSignatureMap;
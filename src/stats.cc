@@ -0,0 +1,172 @@
+#include <cstdio>
+#include <unistd.h>
+#include "stats.h"
+#include "misc.h"
+#include "log.h"
+
+using std::to_string;
+
+namespace {
+  // trivially constructed and zeroed, so operator new can use them on any thread at any time
+  thread_local allocationCounter ownCounter;
+  thread_local allocationCounter* chargedCounter = nullptr;
+
+  string escapeJSON(const string& text) {
+    string result;
+    for (unsigned int i = 0; i < text.size(); i++) {
+      if (text[i] == '"' || text[i] == '\\') {
+        result += '\\';
+      }
+      if ((unsigned char)text[i] < 0x20) {
+        result += formatNumber("\\u%04x", (unsigned char)text[i]);
+        continue;
+      }
+      result += text[i];
+    }
+    return result;
+  }
+}
+
+allocationCounter* getAllocationCounter() {
+  return chargedCounter != nullptr ? chargedCounter : &ownCounter;
+}
+
+allocationScope::allocationScope(allocationCounter* counter) {
+  previous = chargedCounter;
+  chargedCounter = counter;
+}
+
+allocationScope::~allocationScope() {
+  chargedCounter = previous;
+}
+
+void recordAllocation(size_t size) {
+  allocationCounter* counter = getAllocationCounter();
+  counter->count.fetch_add(1, std::memory_order_relaxed);
+  counter->bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+long long getAllocationCount() {
+  return getAllocationCounter()->count.load(std::memory_order_relaxed);
+}
+
+long long getAllocatedBytes() {
+  return getAllocationCounter()->bytes.load(std::memory_order_relaxed);
+}
+
+long long getResidentBytes() {
+  long long pages = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) {
+    return 0;
+  }
+  if (fscanf(statm, "%*s %lld", &pages) != 1) {
+    pages = 0;
+  }
+  fclose(statm);
+  return pages * sysconf(_SC_PAGESIZE);
+}
+
+void loadStats::clear() {
+  stages.clear();
+  values.clear();
+  stageOpen = false;
+}
+
+void loadStats::begin(const string& name) {
+  finish();
+  stages.push_back({name, 0, 0, 0, 0});
+  stageOpen = true;
+  stageStart = steady_clock::now();
+  stageAllocations = getAllocationCount();
+  stageBytes = getAllocatedBytes();
+}
+
+void loadStats::finish() {
+  if (!stageOpen) {
+    return;
+  }
+  loadStage& stage = stages.back();
+  stage.ms = std::chrono::duration<double, std::milli>(steady_clock::now() - stageStart).count();
+  stage.allocations = getAllocationCount() - stageAllocations;
+  stage.allocatedBytes = getAllocatedBytes() - stageBytes;
+  stage.residentBytes = getResidentBytes();
+  stageOpen = false;
+}
+
+void loadStats::setValue(const string& name, long long value) {
+  for (unsigned int i = 0; i < values.size(); i++) {
+    if (values[i].first == name) {
+      values[i].second = value;
+      return;
+    }
+  }
+  values.push_back({name, value});
+}
+
+vector<string> loadStats::report() {
+  vector<string> lines;
+  double total = 0;
+  for (unsigned int i = 0; i < stages.size(); i++) {
+    const loadStage& s = stages[i];
+    total += s.ms;
+    lines.push_back(s.name + ": " + formatNumber("%.2f", s.ms) + " ms, " + to_string(s.allocations) + " allocations, " +
+                    formatNumber("%.1f", s.allocatedBytes / 1048576.0) + " MB allocated, " +
+                    formatNumber("%.1f", s.residentBytes / 1048576.0) + " MB resident");
+  }
+  lines.push_back("total: " + formatNumber("%.2f", total) + " ms");
+  return lines;
+}
+
+string loadStats::toJSON(const string& source) {
+  string json = "{\n  \"file\": \"" + escapeJSON(source) + "\",\n";
+  for (unsigned int i = 0; i < values.size(); i++) {
+    json += "  \"" + escapeJSON(values[i].first) + "\": " + to_string(values[i].second) + ",\n";
+  }
+
+  double total = 0;
+  json += "  \"stages\": [\n";
+  for (unsigned int i = 0; i < stages.size(); i++) {
+    const loadStage& s = stages[i];
+    total += s.ms;
+    json += "    {\"name\": \"" + escapeJSON(s.name) + "\", \"ms\": " + formatNumber("%.3f", s.ms) +
+            ", \"allocations\": " + to_string(s.allocations) + ", \"allocated_bytes\": " + to_string(s.allocatedBytes) +
+            ", \"resident_bytes\": " + to_string(s.residentBytes) + "}" + (i + 1 < stages.size() ? ",\n" : "\n");
+  }
+  json += "  ],\n  \"total_ms\": " + formatNumber("%.3f", total) + "\n}\n";
+  return json;
+}
+
+bool loadStats::saveJSON(const string& filename, const string& source) {
+  FILE* out = fopen(filename.c_str(), "w");
+  if (out == nullptr) {
+    logII(LL_WARN, "unable to write load statistics: " + filename);
+    return false;
+  }
+  string json = toJSON(source);
+  bool success = fwrite(json.data(), 1, json.size(), out) == json.size();
+  fclose(out);
+  return success;
+}
+
+bool parseStatsArgs(int argc, char* argv[], string& input, string& output) {
+  input = "";
+  output = "";
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--stats" && i + 1 < argc) {
+      output = argv[++i];
+    }
+    else if (arg.compare(0, 2, "--")) {
+      input = arg;
+    }
+  }
+  if (output.empty()) {
+    return false;
+  }
+  if (input.empty()) {
+    logII(LL_WARN, "usage: kelumi <file> --stats <output.json>");
+    return false;
+  }
+  return true;
+}
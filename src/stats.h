@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include "color.h"
+
+using std::atomic;
+using std::pair;
+using std::string;
+using std::vector;
+using std::chrono::steady_clock;
+
+// raylib's, only the app side that draws needs its definition
+struct Font;
+
+// heap allocations charged to one thread, pool workers add to it while running that thread's chunks
+struct allocationCounter {
+  atomic<long long> count;
+  atomic<long long> bytes;
+};
+
+// where the calling thread's allocations go at the moment
+allocationCounter* getAllocationCounter();
+
+// charges the calling thread's allocations to counter until it goes out of scope
+class allocationScope {
+  public:
+    allocationScope(allocationCounter* counter);
+    ~allocationScope();
+
+  private:
+    allocationCounter* previous;
+};
+
+// heap allocations made through operator new so far by the calling thread and the pool work it handed
+// out, so a load's figures leave out the render thread, only counted in programs linking alloccount.o,
+// the core library leaves operator new alone and reads 0 without it
+long long getAllocationCount();
+long long getAllocatedBytes();
+// called by the counting operator new for every allocation
+void recordAllocation(size_t size);
+// resident set size of the process, 0 where it cannot be read
+long long getResidentBytes();
+
+struct loadStage {
+  string name;
+  double ms;
+  long long allocations;
+  long long allocatedBytes;
+  // resident size when the stage ended
+  long long residentBytes;
+};
+
+// wall time and memory of each stage of a file load
+class loadStats {
+  public:
+    loadStats() {
+      stages = {};
+      values = {};
+      stageOpen = false;
+      stageAllocations = 0;
+      stageBytes = 0;
+    }
+
+    void clear();
+    // ends the stage in progress, if any, and starts timing the next
+    void begin(const string& name);
+    void finish();
+    // totals worth keeping next to the stages, e.g. the note count
+    void setValue(const string& name, long long value);
+
+    bool empty() { return stages.empty(); }
+    const vector<loadStage>& getStages() { return stages; }
+
+    // one line per stage for the log
+    vector<string> report();
+    string toJSON(const string& source);
+    bool saveJSON(const string& filename, const string& source);
+
+    // table with x, y as the top left corner, defined in statsdraw.cc which is not part of the core library
+    void draw(Font ft, int x, int y, colorRGB fg, colorRGB bg);
+
+  private:
+    vector<loadStage> stages;
+    vector<pair<string, long long>> values;
+
+    bool stageOpen;
+    steady_clock::time_point stageStart;
+    long long stageAllocations;
+    long long stageBytes;
+};
+
+// kelumi <file> --stats <output.json>, loads without opening a window and writes the stage report
+// returns false when the arguments do not ask for it
+bool parseStatsArgs(int argc, char* argv[], string& input, string& output);
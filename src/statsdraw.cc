@@ -0,0 +1,34 @@
+#include "stats.h"
+#include "misc.h"
+#include "wrap.h"
+
+using std::to_string;
+
+// drawing stays with the app, the stage timing in stats.cc is part of the core library
+
+void loadStats::draw(Font ft, int x, int y, colorRGB fg, colorRGB bg) {
+  const int rowHeight = ft.baseSize + 4;
+  const int nameWidth = 120;
+  const int columnWidth = 80;
+  const char* headers[5] = {"stage", "ms", "allocations", "MB allocated", "MB resident"};
+
+  drawRectangle(x, y, nameWidth + 4 * columnWidth + 8, (stages.size() + 2) * rowHeight + 8, bg);
+  for (int c = 0; c < 5; c++) {
+    drawTextEx(ft, headers[c], x + 4 + (c ? nameWidth + (c - 1) * columnWidth : 0), y + 4, fg);
+  }
+
+  double total = 0;
+  for (unsigned int i = 0; i < stages.size(); i++) {
+    const loadStage& s = stages[i];
+    int rowY = y + 4 + (i + 1) * rowHeight;
+    total += s.ms;
+    drawTextEx(ft, s.name, x + 4, rowY, fg);
+    drawTextEx(ft, formatNumber("%.2f", s.ms), x + 4 + nameWidth, rowY, fg);
+    drawTextEx(ft, to_string(s.allocations), x + 4 + nameWidth + columnWidth, rowY, fg);
+    drawTextEx(ft, formatNumber("%.1f", s.allocatedBytes / 1048576.0), x + 4 + nameWidth + 2 * columnWidth, rowY, fg);
+    drawTextEx(ft, formatNumber("%.1f", s.residentBytes / 1048576.0), x + 4 + nameWidth + 3 * columnWidth, rowY, fg);
+  }
+  int rowY = y + 4 + (stages.size() + 1) * rowHeight;
+  drawTextEx(ft, "total", x + 4, rowY, fg);
+  drawTextEx(ft, formatNumber("%.2f", total), x + 4 + nameWidth, rowY, fg);
+}
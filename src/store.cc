@@ -0,0 +1,167 @@
+#include "store.h"
+
+namespace {
+  // moves every element with a new index to it, new indices never exceed old ones
+  template <typename T>
+  void compact(vector<T>& values, const vector<int>& remap, int size) {
+    for (unsigned int i = 0; i < remap.size(); i++) {
+      if (remap[i] != -1) {
+        values[remap[i]] = values[i];
+      }
+    }
+    values.resize(size);
+  }
+}
+
+void noteStore::clear() {
+  start.clear();
+  duration.clear();
+  pitch.clear();
+  track.clear();
+  velocity.clear();
+  channel.clear();
+  on.clear();
+  lastOnTrack.clear();
+  prev.clear();
+  next.clear();
+  chordNext.clear();
+  controls.clear();
+  tails.clear();
+}
+
+void noteStore::reserve(int count) {
+  start.reserve(count);
+  duration.reserve(count);
+  pitch.reserve(count);
+  track.reserve(count);
+  velocity.reserve(count);
+  channel.reserve(count);
+  on.reserve(count);
+  lastOnTrack.reserve(count);
+  prev.reserve(count);
+  next.reserve(count);
+  chordNext.reserve(count);
+}
+
+void noteStore::resize(int count) {
+  start.resize(count, 0);
+  duration.resize(count, 0);
+  pitch.resize(count, 0);
+  track.resize(count, 0);
+  velocity.resize(count, 0);
+  channel.resize(count, 0);
+  on.resize(count, 0);
+  lastOnTrack.resize(count, 0);
+  prev.resize(count, -1);
+  next.resize(count, -1);
+  chordNext.resize(count, -1);
+  tails.clear();
+}
+
+int noteStore::add(double noteStart, double noteDuration, int notePitch, int noteTrack, int noteVelocity,
+                   int noteChannel) {
+  int idx = size();
+  start.push_back(noteStart);
+  duration.push_back(noteDuration);
+  pitch.push_back(notePitch);
+  track.push_back(noteTrack);
+  velocity.push_back(noteVelocity);
+  channel.push_back(noteChannel);
+  on.push_back(0);
+  lastOnTrack.push_back(0);
+  prev.push_back(-1);
+  next.push_back(-1);
+  chordNext.push_back(-1);
+
+  if (noteTrack >= (int)tails.size()) {
+    tails.resize(noteTrack + 1, -1);
+  }
+  int tail = tails[noteTrack];
+  if (tail != -1) {
+    if (start[tail] == noteStart) {
+      chordNext[tail] = idx;
+      prev[idx] = tail;
+    }
+    else {
+      // find chord root
+      int p = tail;
+      while (prev[p] != -1 && start[prev[p]] == start[p]) {
+        p = prev[p];
+      }
+      next[p] = idx;
+      prev[idx] = p;
+    }
+  }
+  tails[noteTrack] = idx;
+
+  return idx;
+}
+
+void noteStore::finish() {
+  for (unsigned int i = 0; i < tails.size(); i++) {
+    if (tails[i] != -1) {
+      lastOnTrack[tails[i]] = 1;
+    }
+  }
+}
+
+void noteStore::eraseFront(int count, const vector<int>& keep, vector<int>& remap) {
+  count = count < size() ? count : size();
+  remap.assign(size(), -1);
+  for (unsigned int i = 0; i < keep.size(); i++) {
+    remap[keep[i]] = i;
+  }
+  for (int i = count; i < size(); i++) {
+    remap[i] = i - count + keep.size();
+  }
+  int remaining = size() - count + keep.size();
+
+  compact(start, remap, remaining);
+  compact(duration, remap, remaining);
+  compact(pitch, remap, remaining);
+  compact(track, remap, remaining);
+  compact(velocity, remap, remaining);
+  compact(channel, remap, remaining);
+  compact(on, remap, remaining);
+  compact(lastOnTrack, remap, remaining);
+  compact(prev, remap, remaining);
+  compact(next, remap, remaining);
+  compact(chordNext, remap, remaining);
+
+  // links into the erased notes are dropped
+  const auto rebase = [&remap] (int& link) {
+    if (link != -1) {
+      link = remap[link];
+    }
+  };
+  for (int i = 0; i < size(); i++) {
+    rebase(prev[i]);
+    rebase(next[i]);
+    rebase(chordNext[i]);
+  }
+  for (unsigned int i = 0; i < tails.size(); i++) {
+    rebase(tails[i]);
+  }
+}
+
+int noteStore::getNextChordRoot(int idx) {
+  int p = idx;
+  while (!isChordRoot(p)) {
+    if (prev[p] == -1) {
+      return idx;
+    }
+    p = prev[p];
+  }
+  return next[p];
+}
+
+int noteStore::getChordSize(int idx) {
+  if (!isChordRoot(idx)) {
+    return 0;
+  }
+  int count = 1;
+  for (int p = chordNext[idx]; p != -1; p = chordNext[p]) {
+    count++;
+  }
+  return count;
+}
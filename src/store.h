@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+// a program or controller change, played back between the notes
+struct channelEvent {
+  double time;
+  // status byte with its channel, then the data bytes, the second unused by program changes
+  uint8_t data[3];
+};
+
+// structure of arrays note storage, hot loops only touch the fields they read
+class noteStore {
+  public:
+    noteStore() {
+      clear();
+    }
+
+    void clear();
+    void reserve(int count);
+    void resize(int count);
+
+    // appends a note and links it to the previous note on its track
+    int add(double noteStart, double noteDuration, int notePitch, int noteTrack, int noteVelocity, int noteChannel = 0);
+    // marks the final note of every track, call once all notes are added
+    void finish();
+    // drops the first count notes except those in keep (ascending, all below count), which move to the
+    // front in order, remap gets the new index of every old one, -1 for dropped notes
+    void eraseFront(int count, const vector<int>& keep, vector<int>& remap);
+
+    int size() { return start.size(); }
+
+    bool isChordRoot(int idx) { return next[idx] != -1 || lastOnTrack[idx]; }
+    int getNextChordRoot(int idx);
+    int getChordSize(int idx);
+
+    vector<double> start;
+    vector<double> duration;
+    vector<uint8_t> pitch;
+    vector<uint16_t> track;
+    vector<uint8_t> velocity;
+    // MIDI channel the note was played on
+    vector<uint8_t> channel;
+    vector<uint8_t> on;
+    vector<uint8_t> lastOnTrack;
+
+    // links are indices into the arrays above, -1 for none
+    vector<int> prev;
+    vector<int> next;
+    vector<int> chordNext;
+
+    // program and controller changes in time order, apart from the notes
+    vector<channelEvent> controls;
+
+  private:
+    vector<int> tails;
+};
@@ -0,0 +1,469 @@
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <sys/stat.h>
+#include "stream.h"
+#include "log.h"
+
+using std::min;
+using std::max;
+using std::sort;
+using std::stable_sort;
+using std::deque;
+using std::make_pair;
+using std::to_string;
+
+namespace {
+  // buffered reader over one MTrk chunk, so tracks never have to fit in memory
+  class trackReader {
+    public:
+      trackReader(FILE* f, long long offset, long long length) : file(f), remaining(length), pos(0), size(0) {
+        buffer.resize(1 << 20);
+        fseeko(file, offset, SEEK_SET);
+      }
+
+      int get() {
+        if (pos >= size && !refill()) {
+          return -1;
+        }
+        return buffer[pos++];
+      }
+
+      long long getVLQ() {
+        long long value = 0;
+        for (int i = 0; i < 4; i++) {
+          int b = get();
+          if (b < 0) {
+            return -1;
+          }
+          value = (value << 7) | (b & 0x7F);
+          if (!(b & 0x80)) {
+            return value;
+          }
+        }
+        return value;
+      }
+
+      void skip(long long n) {
+        while (n > 0) {
+          if (pos >= size && !refill()) {
+            return;
+          }
+          long long take = min(n, static_cast<long long>(size - pos));
+          pos += take;
+          n -= take;
+        }
+      }
+
+    private:
+      bool refill() {
+        if (remaining <= 0) {
+          return false;
+        }
+        size = fread(buffer.data(), 1, min(static_cast<long long>(buffer.size()), remaining), file);
+        remaining -= size;
+        pos = 0;
+        return size > 0;
+      }
+
+      FILE* file;
+      long long remaining;
+      size_t pos;
+      size_t size;
+      vector<unsigned char> buffer;
+  };
+
+  // walks every event of a track, onChannel(tick, status, a, b) and onMeta(tick, type, data)
+  template <typename C, typename M>
+  long long walkTrack(trackReader& in, C onChannel, M onMeta) {
+    long long tick = 0;
+    int running = 0;
+    vector<unsigned char> meta;
+
+    while (true) {
+      long long delta = in.getVLQ();
+      if (delta < 0) {
+        break;
+      }
+      tick += delta;
+
+      int status = in.get();
+      if (status < 0) {
+        break;
+      }
+
+      if (status == 0xFF) {
+        int type = in.get();
+        long long length = in.getVLQ();
+        if (type < 0 || length < 0) {
+          break;
+        }
+        if (type == 0x2F) {
+          break;
+        }
+        if (length > 0xFFFF) {
+          in.skip(length);
+          continue;
+        }
+        meta.resize(length);
+        for (long long i = 0; i < length; i++) {
+          meta[i] = in.get();
+        }
+        onMeta(tick, type, meta);
+        continue;
+      }
+      if (status == 0xF0 || status == 0xF7) {
+        in.skip(in.getVLQ());
+        continue;
+      }
+
+      int a = 0;
+      if (status & 0x80) {
+        running = status;
+        a = in.get();
+      }
+      else {
+        // running status, this byte is the first data byte
+        a = status;
+        status = running;
+      }
+      if (!(status & 0x80)) {
+        logII(LL_WARN, "malformed track data");
+        break;
+      }
+
+      int b = 0;
+      if ((status & 0xF0) != 0xC0 && (status & 0xF0) != 0xD0) {
+        b = in.get();
+      }
+      if (a < 0 || b < 0) {
+        break;
+      }
+      onChannel(tick, status, a, b);
+    }
+    return tick;
+  }
+}
+
+midiStream::~midiStream() {
+  close();
+}
+
+void midiStream::close() {
+  if (source != nullptr) {
+    fclose(source);
+  }
+  if (spill != nullptr) {
+    fclose(spill);
+  }
+  source = nullptr;
+  spill = nullptr;
+
+  store.clear();
+  trackHeightMap.clear();
+  segments.clear();
+  pending.clear();
+  tracks.clear();
+  tempo.clear();
+  noteIdx.clear();
+  pickIdx.clear();
+
+  division = 0;
+  trackCount = 0;
+  lastTick = 0;
+  totalNotes = 0;
+  pendingNotes = 0;
+  spillSize = 0;
+  lastTime = 0;
+  smpteUnitsPerTick = 0;
+  firstResident = -1;
+  lastResident = -1;
+}
+
+bool midiStream::open(string filename, loadProgress* progress) {
+  close();
+
+  source = fopen(filename.c_str(), "rb");
+  if (source == nullptr) {
+    logII(LL_WARN, "unable to open MIDI");
+    return false;
+  }
+  spill = tmpfile();
+  if (spill == nullptr) {
+    logII(LL_WARN, "unable to create stream spill file");
+    close();
+    return false;
+  }
+
+  if (!readHeader() || !readTempo() || !readNotes(progress)) {
+    close();
+    return false;
+  }
+
+  // source is no longer needed, everything lives in the spill file
+  fclose(source);
+  source = nullptr;
+
+  log3(LL_INFO, "streaming notes", totalNotes);
+  log3(LL_INFO, "spill bytes", spillSize);
+  update(0, STREAM_SEGMENT);
+  return true;
+}
+
+bool midiStream::readHeader() {
+  unsigned char header[14];
+  if (fread(header, 1, 14, source) != 14 || memcmp(header, "MThd", 4) != 0) {
+    logII(LL_WARN, "invalid MIDI header");
+    return false;
+  }
+  long long headerLength = (header[4] << 24) | (header[5] << 16) | (header[6] << 8) | header[7];
+  division = (header[12] << 8) | header[13];
+  if (!division) {
+    logII(LL_WARN, "invalid MIDI division");
+    return false;
+  }
+  if (division & 0x8000) {
+    // SMPTE timing, fixed ticks per second
+    int fps = -static_cast<signed char>(division >> 8);
+    int ticksPerFrame = division & 0xFF;
+    smpteUnitsPerTick = 500.0 / (fps * ticksPerFrame);
+  }
+
+  // find every track chunk without reading its contents
+  long long offset = 8 + headerLength;
+  while (true) {
+    unsigned char chunkHeader[8];
+    if (fseeko(source, offset, SEEK_SET) != 0 || fread(chunkHeader, 1, 8, source) != 8) {
+      break;
+    }
+    long long length = ((long long)chunkHeader[4] << 24) | (chunkHeader[5] << 16) | (chunkHeader[6] << 8) | chunkHeader[7];
+    if (memcmp(chunkHeader, "MTrk", 4) == 0) {
+      tracks.push_back({offset + 8, length});
+    }
+    offset += 8 + length;
+  }
+
+  trackCount = tracks.size();
+  if (!trackCount) {
+    logII(LL_WARN, "MIDI has no tracks");
+    return false;
+  }
+  return true;
+}
+
+bool midiStream::readTempo() {
+  vector<pair<long long, double>> changes;
+
+  for (int i = 0; i < trackCount; i++) {
+    trackReader in(source, tracks[i].offset, tracks[i].length);
+    long long end = walkTrack(in, [](long long, int, int, int) {},
+      [&](long long tick, int type, vector<unsigned char>& data) {
+        if (type == 0x51 && data.size() == 3) {
+          changes.push_back(make_pair(tick, (data[0] << 16) | (data[1] << 8) | data[2]));
+        }
+      });
+    lastTick = max(lastTick, end);
+  }
+
+  stable_sort(changes.begin(), changes.end(), [](const pair<long long, double>& left, const pair<long long, double>& right) {
+    return left.first < right.first;
+  });
+
+  // cumulative tempo map in time units (1/500 s)
+  double usPerQuarter = 500000;
+  tempo.push_back({0, 0, usPerQuarter / division});
+  for (unsigned int i = 0; i < changes.size(); i++) {
+    tempoPoint& last = tempo.back();
+    double time = last.time + (changes[i].first - last.tick) * last.usPerTick / 2000.0;
+    if (changes[i].first == last.tick) {
+      last.usPerTick = changes[i].second / division;
+    }
+    else {
+      tempo.push_back({changes[i].first, time, changes[i].second / division});
+    }
+  }
+
+  unsigned int cursor = 0;
+  lastTime = tickToTime(lastTick, cursor);
+
+  segments.resize(static_cast<int>(lastTime / STREAM_SEGMENT) + 1);
+  pending.resize(segments.size());
+  return true;
+}
+
+double midiStream::tickToTime(long long tick, unsigned int& cursor) {
+  if (smpteUnitsPerTick) {
+    return tick * smpteUnitsPerTick;
+  }
+  // ticks only move forward within a track, so the cursor rarely moves
+  if (cursor >= tempo.size() || tempo[cursor].tick > tick) {
+    cursor = 0;
+  }
+  while (cursor + 1 < tempo.size() && tempo[cursor + 1].tick <= tick) {
+    cursor++;
+  }
+  return tempo[cursor].time + (tick - tempo[cursor].tick) * tempo[cursor].usPerTick / 2000.0;
+}
+
+bool midiStream::readNotes(loadProgress* progress) {
+  vector<long long> pitchSum(trackCount, 0);
+  vector<long long> pitchCount(trackCount, 0);
+  if (progress != nullptr) {
+    progress->stage = LOAD_NOTES;
+    progress->fraction = 0;
+  }
+
+  for (int i = 0; i < trackCount; i++) {
+    if (progress != nullptr && progress->cancel) {
+      return false;
+    }
+    // note ons waiting for their note off, per channel and key
+    vector<deque<pair<double, int>>> active(16 * 128);
+    unsigned int cursor = 0;
+    trackReader in(source, tracks[i].offset, tracks[i].length);
+
+    long long end = walkTrack(in, [&](long long tick, int status, int key, int velocity) {
+        int type = status & 0xF0;
+        int slot = (status & 0x0F) * 128 + (key & 0x7F);
+        if (type == 0x90 && velocity > 0) {
+          active[slot].push_back(make_pair(tickToTime(tick, cursor), velocity));
+        }
+        else if ((type == 0x80 || type == 0x90) && !active[slot].empty()) {
+          double start = active[slot].front().first;
+          addNote(start, tickToTime(tick, cursor) - start, i, key, active[slot].front().second);
+          active[slot].pop_front();
+          pitchSum[i] += key;
+          pitchCount[i]++;
+        }
+      },
+      [](long long, int, vector<unsigned char>&) {});
+
+    // close notes left hanging at the end of the track
+    double endTime = tickToTime(end, cursor);
+    for (unsigned int slot = 0; slot < active.size(); slot++) {
+      for (unsigned int j = 0; j < active[slot].size(); j++) {
+        addNote(active[slot][j].first, endTime - active[slot][j].first, i, slot % 128, active[slot][j].second);
+      }
+    }
+
+    if (!flushPending()) {
+      return false;
+    }
+    if (progress != nullptr) {
+      progress->fraction = static_cast<float>(i + 1) / trackCount;
+    }
+  }
+
+  if (!totalNotes) {
+    logII(LL_WARN, "zero length file");
+    return false;
+  }
+
+  for (int i = 0; i < trackCount; i++) {
+    trackHeightMap.push_back(make_pair(i, pitchCount[i] ? (double)pitchSum[i] / pitchCount[i] : 0.0));
+  }
+  sort(trackHeightMap.begin(), trackHeightMap.end(), [](const pair<int, double> &left, const pair<int, double> &right) {
+    return left.second < right.second;
+  });
+  return true;
+}
+
+void midiStream::addNote(double start, double duration, int track, int key, int velocity) {
+  int last = segments.size() - 1;
+  int first = min(max(static_cast<int>(start / STREAM_SEGMENT), 0), last);
+  int end = min(max(static_cast<int>((start + duration) / STREAM_SEGMENT), first), last);
+
+  // notes crossing a boundary are copied into each later segment they overlap
+  for (int k = first; k <= end; k++) {
+    pending[k].push_back({start, static_cast<float>(duration), static_cast<uint16_t>(track), static_cast<uint8_t>(key),
+                          static_cast<uint8_t>((velocity & 0x7F) | (k != first ? 0x80 : 0))});
+    pendingNotes++;
+  }
+  totalNotes++;
+
+  if (pendingNotes >= STREAM_BUFFER_NOTES) {
+    flushPending();
+  }
+}
+
+bool midiStream::flushPending() {
+  for (unsigned int k = 0; k < pending.size(); k++) {
+    if (pending[k].empty()) {
+      continue;
+    }
+    if (fseeko(spill, spillSize, SEEK_SET) != 0 ||
+        fwrite(pending[k].data(), sizeof(streamNote), pending[k].size(), spill) != pending[k].size()) {
+      logII(LL_WARN, "unable to write stream spill file");
+      return false;
+    }
+    segments[k].push_back({spillSize, static_cast<uint32_t>(pending[k].size())});
+    spillSize += pending[k].size() * sizeof(streamNote);
+
+    vector<streamNote>().swap(pending[k]);
+  }
+  pendingNotes = 0;
+  return true;
+}
+
+void midiStream::update(double start, double end) {
+  if (!isOpen()) {
+    return;
+  }
+  int last = segments.size() - 1;
+  int first = min(max(static_cast<int>(start / STREAM_SEGMENT), 0), last);
+  int final = min(max(static_cast<int>(end / STREAM_SEGMENT), first), last);
+
+  if (first >= firstResident && final <= lastResident) {
+    return;
+  }
+
+  // keep one segment of slack on each side so scrolling does not page every frame
+  first = max(first - 1, 0);
+  final = min(final + 1, last);
+  if (final - first + 1 > STREAM_MAX_SEGMENTS) {
+    int mid = (first + final) / 2;
+    first = max(mid - STREAM_MAX_SEGMENTS / 2, 0);
+    final = min(first + STREAM_MAX_SEGMENTS - 1, last);
+  }
+  page(first, final);
+}
+
+void midiStream::page(int first, int last) {
+  store.clear();
+  vector<streamNote> buffer;
+
+  for (int k = first; k <= last; k++) {
+    for (unsigned int c = 0; c < segments[k].size(); c++) {
+      buffer.resize(segments[k][c].count);
+      if (fseeko(spill, segments[k][c].offset, SEEK_SET) != 0 ||
+          fread(buffer.data(), sizeof(streamNote), buffer.size(), spill) != buffer.size()) {
+        logII(LL_WARN, "unable to read stream segment " + to_string(k));
+        continue;
+      }
+      for (unsigned int j = 0; j < buffer.size(); j++) {
+        const streamNote& rec = buffer[j];
+        if (rec.velocity & 0x80) {
+          // a carried copy is only needed when its original segment is not resident
+          int origin = static_cast<int>(rec.start / STREAM_SEGMENT);
+          if (origin >= first || k != first) {
+            continue;
+          }
+        }
+        store.add(rec.start, rec.duration, rec.key, rec.track, rec.velocity & 0x7F);
+      }
+    }
+  }
+
+  noteIdx.build(store);
+  pickIdx.build(store);
+  firstResident = first;
+  lastResident = last;
+}
+
+bool isStreamable(const string& filename) {
+  struct stat info;
+  if (stat(filename.c_str(), &info) != 0) {
+    return false;
+  }
+  return info.st_size > STREAM_THRESHOLD;
+}
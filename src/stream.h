@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "store.h"
+#include "noteidx.h"
+#include "pickidx.h"
+#include "progress.h"
+
+using std::string;
+using std::vector;
+using std::pair;
+
+// files above this size are streamed instead of fully loaded
+#define STREAM_THRESHOLD (256ll << 20)
+// time covered by one on-disk segment (10 s)
+#define STREAM_SEGMENT 5000
+// most segments kept resident, caps memory when zoomed far out
+#define STREAM_MAX_SEGMENTS 32
+// notes buffered before segment buffers are spilled to disk
+#define STREAM_BUFFER_NOTES (1 << 22)
+
+// compact on-disk note record
+struct streamNote {
+  double start;
+  float duration;
+  uint16_t track;
+  uint8_t key;
+  uint8_t velocity; // high bit marks a copy carried over from an earlier segment
+};
+
+// out-of-core loader, keeps only a sliding window of segments resident
+class midiStream {
+  public:
+    midiStream() {
+      trackHeightMap = {};
+      segments = {};
+      pending = {};
+      tracks = {};
+      tempo = {};
+      source = nullptr;
+      spill = nullptr;
+      close();
+    }
+    ~midiStream();
+
+    // prescans the whole file into the spill, progress reports it and can cancel it
+    bool open(string filename, loadProgress* progress = nullptr);
+    void close();
+
+    // page in the segments covering [start, end], no-op while they are resident
+    void update(double start, double end);
+    void findVisibleNotes(double start, double end, vector<int>& result) { noteIdx.query(start, end, result); }
+    void findNotesNear(int lowPitch, int highPitch, double start, double end, vector<int>& result) {
+      pickIdx.query(lowPitch, highPitch, start, end, result);
+    }
+
+    bool isOpen() { return spill != nullptr; }
+    int getTrackCount() { return trackCount; }
+    int getNoteCount() { return store.size(); }
+    long long getTotalNotes() { return totalNotes; }
+    double getLastTime() { return lastTime; }
+
+    noteStore store;
+    vector<pair<int, double>> trackHeightMap;
+
+  private:
+    struct chunk {
+      uint64_t offset;
+      uint32_t count;
+    };
+
+    struct trackChunk {
+      long long offset;
+      long long length;
+    };
+
+    struct tempoPoint {
+      long long tick;
+      double time;
+      double usPerTick;
+    };
+
+    bool readHeader();
+    bool readTempo();
+    bool readNotes(loadProgress* progress);
+    void addNote(double start, double duration, int track, int key, int velocity);
+    bool flushPending();
+    void page(int first, int last);
+
+    double tickToTime(long long tick, unsigned int& cursor);
+
+    vector<vector<chunk>> segments;
+    vector<vector<streamNote>> pending;
+    vector<trackChunk> tracks;
+    vector<tempoPoint> tempo;
+
+    noteIndex noteIdx;
+    pickIndex pickIdx;
+
+    FILE* source;
+    FILE* spill;
+
+    int division;
+    int trackCount;
+    long long lastTick;
+    long long totalNotes;
+    long long pendingNotes;
+    uint64_t spillSize;
+    double lastTime;
+    double smpteUnitsPerTick;
+
+    int firstResident;
+    int lastResident;
+};
+
+// true for MIDI files large enough to need streaming
+bool isStreamable(const string& filename);
@@ -0,0 +1,134 @@
+#include <algorithm>
+#include "timeline.h"
+
+using std::upper_bound;
+using std::stable_sort;
+using std::max;
+
+enum timelineEvents {
+  TIMELINE_TEMPO,
+  TIMELINE_TIMESIG,
+  TIMELINE_KEYSIG
+};
+
+namespace {
+  struct timelineEvent {
+    int tick;
+    int type;
+    double value;
+  };
+}
+
+void timeline::clear() {
+  segments.clear();
+  ticks.clear();
+  times.clear();
+  tpq = 0;
+}
+
+void timeline::build(int ticksPerQuarter, const vector<pair<int, double>>& tempos, sheetController& sheet) {
+  clear();
+  if (ticksPerQuarter <= 0) {
+    return;
+  }
+  tpq = ticksPerQuarter;
+
+  vector<timelineEvent> events;
+  for (unsigned int i = 0; i < tempos.size(); i++) {
+    events.push_back({tempos[i].first, TIMELINE_TEMPO, tempos[i].second});
+  }
+  for (unsigned int i = 0; i < sheet.timeSignatureMap.size(); i++) {
+    events.push_back({max(sheet.timeSignatureMap[i].second.tick, 0), TIMELINE_TIMESIG, double(i)});
+  }
+  for (unsigned int i = 0; i < sheet.keySignatureMap.size(); i++) {
+    events.push_back({max(sheet.keySignatureMap[i].second.tick, 0), TIMELINE_KEYSIG, double(i)});
+  }
+  stable_sort(events.begin(), events.end(), [](const timelineEvent& left, const timelineEvent& right) {
+    return left.tick < right.tick;
+  });
+
+  // MIDI defaults to 120 bpm until the first tempo event
+  const auto unitsPerTick = [&] (double bpm) {
+    return 60.0 / bpm / tpq * 500;
+  };
+  segments.push_back({0, 0, unitsPerTick(120), 120, -1, -1});
+
+  for (unsigned int i = 0; i < events.size(); i++) {
+    timelineSegment last = segments.back();
+    if (events[i].tick > last.tick) {
+      // changes at a new tick open a segment, changes on the same tick amend it
+      last.time += (events[i].tick - last.tick) * last.unitsPerTick;
+      last.tick = events[i].tick;
+      segments.push_back(last);
+    }
+    timelineSegment& seg = segments.back();
+    switch (events[i].type) {
+      case TIMELINE_TEMPO:
+        if (events[i].value > 0) {
+          seg.bpm = events[i].value;
+          seg.unitsPerTick = unitsPerTick(seg.bpm);
+        }
+        break;
+      case TIMELINE_TIMESIG:
+        seg.timeSig = events[i].value;
+        break;
+      case TIMELINE_KEYSIG:
+        seg.keySig = events[i].value;
+        break;
+    }
+  }
+
+  ticks.resize(segments.size());
+  times.resize(segments.size());
+  for (unsigned int i = 0; i < segments.size(); i++) {
+    ticks[i] = segments[i].tick;
+    times[i] = segments[i].time;
+  }
+}
+
+int timeline::findByTick(int tick) {
+  int idx = upper_bound(ticks.begin(), ticks.end(), tick) - ticks.begin() - 1;
+  return max(idx, 0);
+}
+
+int timeline::findByTime(double time) {
+  int idx = upper_bound(times.begin(), times.end(), time) - times.begin() - 1;
+  return max(idx, 0);
+}
+
+double timeline::tickToTime(int tick) {
+  if (segments.empty()) {
+    return 0;
+  }
+  const timelineSegment& seg = segments[findByTick(tick)];
+  return seg.time + (tick - seg.tick) * seg.unitsPerTick;
+}
+
+int timeline::timeToTick(double time) {
+  if (segments.empty()) {
+    return 0;
+  }
+  const timelineSegment& seg = segments[findByTime(time)];
+  return seg.tick + static_cast<int>((time - seg.time) / seg.unitsPerTick);
+}
+
+double timeline::getTempo(double time) {
+  if (segments.empty()) {
+    return 120;
+  }
+  return segments[findByTime(time)].bpm;
+}
+
+int timeline::getTimeSigAtTick(int tick) {
+  if (segments.empty()) {
+    return -1;
+  }
+  return segments[findByTick(tick)].timeSig;
+}
+
+int timeline::getKeySigAtTick(int tick) {
+  if (segments.empty()) {
+    return -1;
+  }
+  return segments[findByTick(tick)].keySig;
+}
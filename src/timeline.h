@@ -0,0 +1,53 @@
+#pragma once
+
+#include <vector>
+#include "sheetctr.h"
+
+using std::vector;
+using std::pair;
+
+// a stretch of the song where tempo, meter and key are all constant
+struct timelineSegment {
+  int tick;
+  double time;
+  double unitsPerTick;
+  double bpm;
+  // indices into the sheetController signature maps, -1 before the first one
+  int timeSig;
+  int keySig;
+};
+
+// cumulative tempo/meter/key map, every lookup is a binary search in either
+// the tick or the time domain (time is in 1/500 s like everything else)
+class timeline {
+  public:
+    timeline() {
+      segments = {};
+      ticks = {};
+      times = {};
+      tpq = 0;
+    }
+
+    void clear();
+    // tempos are (tick, bpm) pairs, signatures are read from the sheet controller
+    void build(int ticksPerQuarter, const vector<pair<int, double>>& tempos, sheetController& sheet);
+
+    bool empty() { return segments.empty(); }
+
+    double tickToTime(int tick);
+    int timeToTick(double time);
+
+    double getTempo(double time);
+    int getTimeSigAtTick(int tick);
+    int getKeySigAtTick(int tick);
+
+  private:
+    int findByTick(int tick);
+    int findByTime(double time);
+
+    vector<timelineSegment> segments;
+    // search keys kept apart from the segments so lookups stay in cache
+    vector<int> ticks;
+    vector<double> times;
+    int tpq;
+};
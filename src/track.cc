@@ -1,64 +1,15 @@
 #include <string>
-#include <iostream>
 #include "track.h"
 
 using std::to_string;
-using std::pair;
-using std::cout;
-using std::endl;
 
-void trackController::insert(int idx, note* newNote) {
-  if (newNote == nullptr) {
-    log3(LL_CRIT, "empty note passed to trackController::insert with index", idx);
-    return;
+void trackController::insert(int track, double start, int pitch) {
+  if (noteCount && lastX > start) {
+    logII(LL_WARN, "mismatched note on track" + to_string(track) + " (" + 
+          to_string(lastX) + " → " + to_string(start) + ")");
   }
-  if (tail != nullptr && tail->x > newNote->x) {
-    logII(LL_WARN, "mismatched note on track" + to_string(newNote->track) + " (" + 
-          to_string(tail->x) + " → " + to_string(newNote->x) + ")");
-  }
-  if (head == nullptr) {
-    head = newNote;
-  }
-  if (tail == nullptr) {
-    tail = newNote;
-  }
-  else if (tail->x == newNote->x) {
-    tail->chordNext = newNote;
-    newNote->prev = tail;
-  }
-  else {
-    // find chord root
-    note* p = tail;
-    while (p->prev != nullptr && p->prev->x == p->x) {
-      p = p->prev;
-    }
-    p->next = newNote;
-    newNote->prev = p;
-  }
-  
-  tail = newNote;
+  lastX = start;
 
-  noteIdxMap.insert(pair<int, note*>(idx, newNote));
   noteCount++;
-  noteSum+= newNote->y;
-}
-
-note* trackController::getNote(int idx) {
-  note* noteptr = nullptr;
-  try {
-    noteptr = noteIdxMap.at(idx);
-  }
-  catch (const std::out_of_range& e) {
-    //logII(LL_INFO, "note not found");
-    return nullptr;
-  }
-  return noteptr;
-}
-
-note* trackController::getLastNote() {
-  return noteIdxMap[noteIdxMap.size() - 1];
-}
-
-void trackController::fixLastNote() {
-  getLastNote()->isLastOnTrack = true;
+  noteSum+= pitch;
 }
@@ -1,33 +1,22 @@
 #pragma once
 
-#include <map>
-#include "note.h"
 #include "log.h"
 
-using std::map;
-
+// running totals per track, the notes themselves are in midi::store
 class trackController {
   public:
     trackController() {
-      noteIdxMap = {};
-      head = nullptr;
-      tail = nullptr;
+      lastX = 0;
       noteCount = 0;
       noteSum = 0;
     }
 
-    void insert(int idx, note* newNote);
-    void fixLastNote();
-    note* getNote(int idx);
+    void insert(int track, double start, int pitch);
     int getNoteCount() { return noteCount; }
     double getAverageY() { return (double)noteSum/noteCount; }
 
   private:
-    note* getLastNote();
-    
-    map<int, note*> noteIdxMap;
-    note* head;
-    note* tail;
+    double lastX;
     int noteCount;
     int noteSum;
     
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+using std::chrono::duration_cast;
+
+// playback position worked out from a fixed point on the system clock, so frame
+// timing never adds up into drift and anything sharing a copy stays in step
+class transport {
+  public:
+    transport() {
+      anchorTime = 0;
+      anchorClock = steady_clock::now();
+      rate = 1;
+      running = false;
+    }
+
+    void play() {
+      if (!running) {
+        anchorClock = steady_clock::now();
+        running = true;
+      }
+    }
+    void pause() {
+      anchorTime = getTime();
+      running = false;
+    }
+    void seek(double time) {
+      anchorTime = time;
+      anchorClock = steady_clock::now();
+    }
+    // speed relative to the file, the position carries on from where it is
+    void setRate(double newRate) {
+      if (newRate > 0) {
+        seek(getTime());
+        rate = newRate;
+      }
+    }
+
+    bool isRunning() const { return running; }
+    double getRate() const { return rate; }
+    // where the clock was last started, paused or moved
+    double getAnchor() const { return anchorTime; }
+
+    // song time, in the same 1/500 s units as note starts
+    double getTime() const {
+      if (!running) {
+        return anchorTime;
+      }
+      return anchorTime + duration<double>(steady_clock::now() - anchorClock).count() * 500 * rate;
+    }
+    // when a song time comes up while running
+    steady_clock::time_point toClock(double time) const {
+      return anchorClock + duration_cast<steady_clock::duration>(duration<double>((time - anchorTime) / (500 * rate)));
+    }
+
+  private:
+    double anchorTime;
+    steady_clock::time_point anchorClock;
+    double rate;
+    bool running;
+};
@@ -1,38 +1,55 @@
 #include "wrap.h"
+#include "profile.h"
+
+bool pointInBox(Vector2 mouse, rect box) {
+  if (mouse.x >= box.x && mouse.x < box.x + box.width &&
+      mouse.y >= box.y && mouse.y < box.y + box.height) {
+    return true;
+  }
+  return false;
+}
 
 void drawLine(int xi, int yi, int xf, int yf, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawLine(xi, yi, xf, yf, color);
 }
 void clearBackground(colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   ClearBackground(color);
 }
 void drawRectangle(int x, int y, int w, int h, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawRectangle(x, y, w, h, color);
 }
 void drawLineEx(int xi, int yi, int xf, int yf, float thick, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawLineEx((Vector2){(float)xi, (float)yi}, (Vector2){(float)xf, (float)yf}, thick, color);
 }
 
 void drawTextEx(Font ft, string msg, int x, int y, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawTextEx(ft, msg.c_str(), (Vector2){static_cast<float>(x), static_cast<float>(y)}, ft.baseSize, 0.5, color);
 }
 
 void drawCircle(int x, int y, float r, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawCircle(x, y, r, color);
 }
 
 void drawCircleLines(int x, int y, float r, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawCircleLines(x, y, r, color);
 }
 
 void drawRing(Vector2 center, float iRad, float oRad, colorRGB col) {
+  profiler.count(COUNT_DRAWCALLS);
   Color color = (Color){(unsigned char)col.r, (unsigned char)col.g, (unsigned char)col.b, 255};
   DrawRing(center, iRad, oRad, 0.0f, 360.0f, 1 + oRad, color);
 }
@@ -4,9 +4,12 @@
 #include <raylib.h>
 #include "color.h"
 #include "data.h"
+#include "box.h"
 
 using std::string;
 
+bool pointInBox(Vector2 mouse, rect box);
+
 void clearBackground(colorRGB col);
 void drawRectangle(int x, int y, int w, int h, colorRGB col);
 void drawLine(int xi, int yi, int xf, int yf, colorRGB col);